@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <utility>
+#include <algorithm>
+
+namespace genetic {
+    // A linearis GP programok (path_finding_program,
+    // traveling_salesman_program) meretnovekedesenek ("bloat") korlatozasa.
+    struct bloat_control {
+        // A keresztezes eredmenye legfeljebb ilyen hosszu lehet; ha hosszabb
+        // lenne, helyette az elso szulo masolata lesz a gyerek. 0 = nincs
+        // korlat.
+        size_t max_length = 0;
+
+        // Meretaranyos (size-fair) keresztezes: a masodik szulobol beszurt
+        // szakasz legfeljebb 1 + 2 * (az elso szulobol eldobott szakasz)
+        // hosszu.
+        bool size_fair = false;
+
+        // Tarpeian modszer: az atlagnal hosszabb programok ennyi
+        // valoszinuseggel kiertekeles nelkul a legrosszabb fitnesst kapjak.
+        // 0 = kikapcsolva.
+        float tarpeian_rate = 0;
+
+        // Lexikografikus parszimonia: egyenlo fitness eseten a rovidebb
+        // program a jobb (rendezesnel es a parbajokban).
+        bool lexicographic_parsimony = false;
+    };
+
+    // A keresztezes vagasi pontjai: a gyerek p0[0, first) + p1[second, n1)
+    template<typename Rng>
+    std::pair<size_t, size_t> crossover_points(size_t n0, size_t n1, bloat_control const &bc, Rng &rng) {
+        auto dist_p0_idx = std::uniform_int_distribution(size_t(0), n0 - 1);
+        auto idx_p0 = dist_p0_idx(rng);
+
+        if (!bc.size_fair) {
+            auto dist_p1_idx = std::uniform_int_distribution(size_t(0), n1 - 1);
+            return { idx_p0, dist_p1_idx(rng) };
+        }
+
+        auto removed = n0 - idx_p0;
+        auto max_inserted = std::min(n1, 1 + 2 * removed);
+        auto dist_inserted = std::uniform_int_distribution(size_t(1), max_inserted);
+        return { idx_p0, n1 - dist_inserted(rng) };
+    }
+
+    // Tul hosszu-e egy `length` hosszu gyerek?
+    inline bool exceeds_max_length(size_t length, bloat_control const &bc) {
+        return bc.max_length > 0 && length > bc.max_length;
+    }
+
+    // Megkapja-e egy `length` hosszu program a Tarpeian buntetest?
+    template<typename Rng>
+    bool tarpeian_hit(size_t length, float average_length, bloat_control const &bc, Rng &rng) {
+        if (bc.tarpeian_rate <= 0 || float(length) <= average_length) {
+            return false;
+        }
+        return std::uniform_real_distribution(0.f, 1.f)(rng) < bc.tarpeian_rate;
+    }
+
+    // Jobb-e a (fitness, hossz) paros a masiknal (kisebb fitness a jobb)?
+    inline bool fitter(float lhs_fitness, size_t lhs_length, float rhs_fitness, size_t rhs_length, bloat_control const &bc) {
+        if (lhs_fitness != rhs_fitness || !bc.lexicographic_parsimony) {
+            return lhs_fitness < rhs_fitness;
+        }
+        return lhs_length < rhs_length;
+    }
+}
@@ -1,5 +1,10 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "gen_selection.hpp"
 #include "traveling_salesman.hpp"
+#include "trajectory_log.hpp"
 
 struct city {
     float x, y;
@@ -11,19 +16,62 @@ static float distance(city const &lhs, city const &rhs) {
     return std::sqrt(dx * dx + dy * dy);
 }
 
-static void print_graph(FILE *f, std::vector<city> const &cities, traveling_salesman<city>::path const &path) {
-    fprintf(f, "digraph cities {\n");
-    auto N = path.size();
-    fprintf(f, "C%zu -> C%zu;\n", path[N - 1], path[0]);
-    for (size_t i = 1; i < N; i++) {
-        fprintf(f, "C%zu -> C%zu;\n", path[i - 1], path[i - 0]);
+// Egy kapcsolo nemnegativ egesz erteke; hamis, ha az ertek ures, nem
+// szam vagy tul nagy
+static bool parse_count(char const *text, size_t &out) {
+    if (*text < '0' || *text > '9') {
+        return false;
     }
-    fprintf(f, "\n");
-    for (auto idx : path) {
-        auto &city = cities[idx];
-        fprintf(f, "C%zu [ pos = \"%f,%f!\"];\n", idx, city.x, city.y);
+    char *end;
+    errno = 0;
+    auto value = strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE) {
+        return false;
+    }
+    out = size_t(value);
+    return true;
+}
+
+// A peldany betoltese utan a varosok szama alapjan valasztjuk ki a
+// legkeskenyebb indextipust, amibe meg belefer minden varos.
+template<typename Index>
+static void solve(std::vector<city> const &cities, size_t start_idx, size_t local_search_moves) {
+    using problem_t = traveling_salesman<city, Index>;
+
+    // A legjobb utvonalakat egy hatterszal irja ki egyetlen binaris fajlba;
+    // DOT/gnuplot formatumra a trajectory_convert alakitja at.
+    std::vector<std::pair<float, float>> positions;
+    for (auto &c : cities) {
+        positions.emplace_back(c.x, c.y);
+    }
+    trajectory::writer trajectory_writer("trajectory.bin", positions);
+
+    auto logger = [&](int gen, typename problem_t::path const &best) {
+        if (gen % 5 != 0) {
+            return;
+        }
+        trajectory_writer.push(gen, best);
+    };
+
+    auto problem = problem_t(cities, start_idx);
+    // 2-opt lokalis kereses a mutacio utan (a jelolt szomszedokon)
+    problem.set_local_search(local_search_moves);
+    // Az also korlat a hatterben szamolodik; amint kesz, generacionkent
+    // kiirjuk az optimalitasi rest, es 1% alatt megallunk
+    problem.start_lower_bound();
+
+    auto solver = genetic::algorithm<
+        decltype(problem),
+        decltype(logger)
+    >(problem, 100000, 0.001f, &logger);
+    solver.set_target_gap(0.01f);
+
+    auto solutions = solver.optimize();
+
+    // A tele sor miatt eldobott keretek nem kerultek a fajlba
+    if (auto dropped = trajectory_writer.dropped(); dropped > 0) {
+        fprintf(stderr, "trajectory: %zu frame(s) dropped because the writer queue was full\n", dropped);
     }
-    fprintf(f, "}\n\n");
 }
 
 int main(int argc, char **argv) {
@@ -350,27 +398,26 @@ int main(int argc, char **argv) {
 
     size_t start_idx = 0;
 
-    char path_buf[64];
-
-    auto logger = [&](int gen, std::vector<size_t> const &best) {
-#if __linux__
-        if (gen % 5 != 0) {
-            return;
+    // --local-search=N: a mutacio utan legfeljebb N javito 2-opt lepes
+    // utvonalankent (alapertelmezes: 0, kikapcsolva)
+    size_t local_search_moves = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--local-search=", 15) == 0) {
+            if (!parse_count(argv[i] + 15, local_search_moves)) {
+                fprintf(stderr, "genetic_travelingsalesman: invalid value in '%s'\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "genetic_travelingsalesman: unknown argument '%s'\n", argv[i]);
+            return 1;
         }
-        snprintf(path_buf, 63, "path%09d.dot", gen);
-        FILE *f = fopen(path_buf, "wb");
-        print_graph(f, cities, best);
-        fclose(f);
-#endif
-    };
-
-    auto problem = traveling_salesman(cities, start_idx);
-    auto solver = genetic::algorithm<
-        decltype(problem),
-        decltype(logger)
-    >(problem, 100000, 0.001f, &logger);
+    }
 
-    auto solutions = solver.optimize();
+    if (traveling_salesman<city, uint16_t>::fits_index(cities.size())) {
+        solve<uint16_t>(cities, start_idx, local_search_moves);
+    } else {
+        solve<uint32_t>(cities, start_idx, local_search_moves);
+    }
 
     return 0;
 }
\ No newline at end of file
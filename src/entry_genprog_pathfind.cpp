@@ -1,66 +1,70 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <cstdio>
+#include <cstring>
 #include "vec2.hpp"
 
 #include "gen_selection.hpp"
 #include "path_finding_program.hpp"
+#include "maze_io.hpp"
 #include "particle_swarm_optimization.hpp"
 #include "function_approximation.hpp"
 
-std::vector<path_finding_program::level_tile> load_level(char const *path, int *out_width, int *out_height) {
-    FILE *f;
-
-    f = fopen(path, "r");
-    if (f == nullptr) {
-        fprintf(stderr, "load_level: failed to open '%s' for reading\n", path);
-        std::abort();
-    }
-
-    std::vector<path_finding_program::level_tile> ret;
-    int width = 0;
-    int height = 0;
-
-    while (!feof(f)) {
-        char ch;
-        path_finding_program::level_tile tile;
-
-        fread(&ch, 1, 1, f);
-
-        if (ch == '\n') {
-            if (width == 0) {
-                width = ret.size();
-            }
-
-            height++;
-            continue;
+// Egy palya a parancssorbol: fajl (szoveges vagy binaris), vagy
+// "gen:SZELESSEGxMAGASSAG[:SEED]" eseten generalt labirintus
+static maze_io::maze load_level(char const *spec) {
+    maze_io::maze ret;
+    int width, height;
+    unsigned long long seed = 0;
+    if (sscanf(spec, "gen:%dx%d:%llu", &width, &height, &seed) >= 2) {
+        if (width <= 0 || height <= 0 || width > maze_io::max_side || height > maze_io::max_side) {
+            fprintf(stderr, "genprog_pathfind: generated maze size must be between 1 and %d per side, got '%s'\n", maze_io::max_side, spec);
+            std::abort();
         }
-
-        switch (ch) {
-        case '#': tile = path_finding_program::TILE_WALL; break;
-        case ' ': tile = path_finding_program::TILE_EMPTY; break;
-        case 'S': tile = path_finding_program::TILE_START; break;
-        case 'X': tile = path_finding_program::TILE_EXIT; break;
-        default: fprintf(stderr, "load_level: unknown tile '%c'\n", ch);  std::abort(); break;
-        }
-
-        ret.push_back(tile);
+        return maze_io::generate(width, height, seed);
+    }
+    if (!maze_io::load_level(spec, ret)) {
+        std::abort();
     }
-
-    *out_width = width;
-    *out_height = height - 1; // subtract last empty line
-    fclose(f);
-
     return ret;
 }
 
 int main(int argc, char **argv) {
-    path_finding_program::level L;
+    // A parancssorban megadott palyak (alapertelmezes: labyrinth0.txt); tobb
+    // palya eseten a programokat mindegyiken, parhuzamosan ertekeljuk ki.
+    // A palya lehet fajl vagy generalt ("gen:64x32:1"); a cellak
+    // elrendezese a --layout=row-major|tiled|morton kapcsoloval valaszthato.
+    std::vector<char const *> paths;
+    auto layout = maze_layout::row_major;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--layout=row-major") == 0) {
+            layout = maze_layout::row_major;
+        } else if (strcmp(argv[i], "--layout=tiled") == 0) {
+            layout = maze_layout::tiled;
+        } else if (strcmp(argv[i], "--layout=morton") == 0) {
+            layout = maze_layout::morton;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        paths.push_back("labyrinth0.txt");
+    }
 
-    auto tiles = load_level("labyrinth0.txt", &L.width, &L.height);
-    L.tiles = tiles.data();
+    std::vector<maze_io::maze> mazes;
+    std::vector<path_finding_program::level> levels;
+    std::vector<path_finding_program::level const *> level_ptrs;
+    for (auto path : paths) {
+        mazes.push_back(load_level(path));
+    }
+    for (auto &m : mazes) {
+        levels.push_back(m.level());
+    }
+    for (auto &L : levels) {
+        level_ptrs.push_back(&L);
+    }
 
-    path_finding_program problem(&L);
+    path_finding_program problem(level_ptrs, level_ptrs.size() > 1 ? 0 : 1, layout);
 
     auto logger = [&](int gen, path_finding_program::solution const &best) {
     };
@@ -70,6 +74,13 @@ int main(int argc, char **argv) {
         decltype(logger)
     >(problem, 100000, 0.001f, &logger);
 
+#if GP_PROFILING
+    solver.set_stats_callback([&](int gen, auto const &stats) {
+        printf("profile | generation %d\n", gen);
+        path_finding_program::print_profile(stdout, stats);
+    });
+#endif
+
     auto results = solver.optimize(0.0f);
 
     auto best = problem.find_best_in(results);
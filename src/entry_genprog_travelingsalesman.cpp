@@ -342,10 +342,17 @@ int main(int argc, char **argv) {
         decltype(logger)
     >(problem, 10000, 0.05f, &logger);
 
+#if GP_PROFILING
+    solver.set_stats_callback([&](int gen, auto const &stats) {
+        printf("profile | generation %d\n", gen);
+        traveling_salesman_program<city>::print_profile(stdout, stats);
+    });
+#endif
+
     auto solutions = solver.optimize();
 
     printf("Solutions:\n");
-    for (auto &solution : solutions) {
+    for (auto solution : solutions) {
         problem.print_program(solution);
     }
 
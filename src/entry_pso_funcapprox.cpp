@@ -1,7 +1,29 @@
 #include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
 #include "particle_swarm_optimization.hpp"
 #include "function_approximation.hpp"
 
+// Egy kapcsolo nemnegativ egesz erteke; hamis, ha az ertek ures, nem
+// szam vagy tul nagy
+static bool parse_count(char const *text, size_t &out) {
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    auto value = strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE) {
+        return false;
+    }
+    out = size_t(value);
+    return true;
+}
+
 int main(int argc, char **argv) {
     using problem = function_approx::problem<4>;
     using coef = typename problem::coefficients_t;
@@ -39,6 +61,49 @@ int main(int argc, char **argv) {
     params.phi_g = 0.2f;
     params.phi_p = 0.1f;
     params.max_iterations = 50000;
+    // A raj tarolasa: --backend=aos|soa (alapertelmezes: soa); a soa
+    // backend szalainak szama: --threads=N (alapertelmezes: ahany hardveres
+    // szal van, es ennel tobb sem lehet); a szomszedsagi topologia:
+    // --topology=global|ring|von-neumann|random, a ring es random topologia
+    // parametere: --neighbors=K; aszinkron frissites: --async
+    params.backend = pso::backend::soa;
+    params.n_threads = 0;
+    params.topology = pso::topology::global;
+    for (int i = 1; i < argc; i++) {
+        size_t value;
+        if (strcmp(argv[i], "--backend=aos") == 0) {
+            params.backend = pso::backend::aos;
+        } else if (strcmp(argv[i], "--backend=soa") == 0) {
+            params.backend = pso::backend::soa;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            if (!parse_count(argv[i] + 10, value)) {
+                fprintf(stderr, "pso_funcapprox: invalid value in '%s'\n", argv[i]);
+                return 1;
+            }
+            auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+            params.n_threads = unsigned(std::min(value, size_t(max_threads)));
+        } else if (strcmp(argv[i], "--topology=global") == 0) {
+            params.topology = pso::topology::global;
+        } else if (strcmp(argv[i], "--topology=ring") == 0) {
+            params.topology = pso::topology::ring;
+        } else if (strcmp(argv[i], "--topology=von-neumann") == 0) {
+            params.topology = pso::topology::von_neumann;
+        } else if (strcmp(argv[i], "--topology=random") == 0) {
+            params.topology = pso::topology::random;
+        } else if (strncmp(argv[i], "--neighbors=", 12) == 0) {
+            // A topologia a raj meretere korlatozza
+            if (!parse_count(argv[i] + 12, value)) {
+                fprintf(stderr, "pso_funcapprox: invalid value in '%s'\n", argv[i]);
+                return 1;
+            }
+            params.neighbors = value;
+        } else if (strcmp(argv[i], "--async") == 0) {
+            params.asynchronous = true;
+        } else {
+            fprintf(stderr, "pso_funcapprox: unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
 
     using solver_t = pso::solver<problem>;
     solver_t solver(prob, params);
@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <cstring>
+#include "vec2.hpp"
+#include "gnuplot.hpp"
+#include "trajectory_log.hpp"
+
+// A genetic_travelingsalesman altal irt trajektoria-fajlt alakitja at
+// keretenkent DOT fajlokka vagy gnuplot szkriptekke.
+
+static void print_graph(FILE *f, std::vector<std::pair<float, float>> const &cities, std::vector<uint32_t> const &path) {
+    fprintf(f, "digraph cities {\n");
+    auto N = path.size();
+    fprintf(f, "C%u -> C%u;\n", path[N - 1], path[0]);
+    for (size_t i = 1; i < N; i++) {
+        fprintf(f, "C%u -> C%u;\n", path[i - 1], path[i - 0]);
+    }
+    fprintf(f, "\n");
+    for (auto idx : path) {
+        auto &city = cities[idx];
+        fprintf(f, "C%u [ pos = \"%f,%f!\"];\n", idx, city.first, city.second);
+    }
+    fprintf(f, "}\n\n");
+}
+
+static void print_usage(char const *argv0) {
+    fprintf(stderr, "Usage: %s trajectory.bin dot [prefix]\n", argv0);
+    fprintf(stderr, "       %s trajectory.bin gnuplot\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    trajectory::reader reader(argv[1]);
+    if (!reader.is_open()) {
+        return 1;
+    }
+
+    auto &cities = reader.positions();
+    trajectory::frame frame;
+
+    if (strcmp(argv[2], "dot") == 0) {
+        auto prefix = argc > 3 ? argv[3] : "path";
+        char path_buf[256];
+
+        while (reader.next(frame)) {
+            if (frame.tour.empty()) {
+                continue;
+            }
+            snprintf(path_buf, 255, "%s%09u.dot", prefix, frame.generation);
+            FILE *f = fopen(path_buf, "wb");
+            if (f == nullptr) {
+                fprintf(stderr, "failed to open '%s' for writing\n", path_buf);
+                return 1;
+            }
+            print_graph(f, cities, frame.tour);
+            fclose(f);
+        }
+    } else if (strcmp(argv[2], "gnuplot") == 0) {
+        std::vector<vec2> points;
+        while (reader.next(frame)) {
+            if (frame.tour.empty()) {
+                continue;
+            }
+            points.clear();
+            for (auto idx : frame.tour) {
+                points.push_back({ cities[idx].first, cities[idx].second });
+            }
+
+            char title[64];
+            snprintf(title, 63, "Generation %u", frame.generation);
+            auto plot = gnuplot::polygons_and_points{
+                { gnuplot::polygon, title, points },
+            };
+            fprintf(stdout, "%s\n", plot.str().c_str());
+        }
+    } else {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (reader.rejected() > 0) {
+        fprintf(stderr, "%zu frame(s) skipped because of invalid city indices\n", reader.rejected());
+    }
+
+    return 0;
+}
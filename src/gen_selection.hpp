@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cmath>
+#include <cstdio>
 #include <vector>
+#include <functional>
+#include <type_traits>
 
 namespace genetic {
 #if __cplusplus > 201703L
@@ -67,10 +71,40 @@ namespace genetic {
         requires can_manipulate_populations<P, typename P::population, typename P::evaluated_population>;
         requires can_mutate<P, typename P::solution>;
     };
+
+    // Kepes-e a problema megmondani, hogy a populacio legjobb megoldasa
+    // milyen messze van a celtol? A res jelentese problemankent mas, csak az
+    // kozos, hogy 0 a cel es kisebb a jobb: a TSP-nel a legjobb ut relativ
+    // tobblete egy also korlathoz kepest, a labirintusnal a kijarattol
+    // hatralevo tavolsag a legrovidebb ut hosszahoz kepest.
+    template<typename P>
+    concept reports_optimality_gap = requires(P a, typename P::evaluated_population eval_pop) {
+        { a.optimality_gap(eval_pop) } -> std::convertible_to<float>;
+    };
+
+    // Gyujt-e a problema generacionkenti profilt (lasd gp_profile.hpp)?
+    template<typename P>
+    concept reports_profile = requires(P a) {
+        typename P::profile_stats;
+        { a.take_profile() } -> std::convertible_to<typename P::profile_stats>;
+    };
 #else
 #define genetic_solveable typename
 #endif
 
+    // A profil tipusa; ha a problema nem gyujt profilt, egy ures tipus
+    struct no_profile {};
+
+    template<typename P, typename = void>
+    struct profile_stats_of {
+        using type = no_profile;
+    };
+
+    template<typename P>
+    struct profile_stats_of<P, std::void_t<typename P::profile_stats>> {
+        using type = typename P::profile_stats;
+    };
+
     template<typename T>
     struct dummy_logger {
         void operator()(int gen, T const &) {}
@@ -89,6 +123,22 @@ namespace genetic {
         ) : _problem(problem), _max_generation(max_generation), _mutation_rate(mutation_rate), _logger(logger) {
         }
 
+        // Leallitja az optimalizaciot, ha az optimalitasi res (lasd
+        // reports_optimality_gap) `gap` ala esik. Negativ ertek kikapcsolja.
+        // A `gap` a problema sajat mereseben ertendo (TSP: tobblet az also
+        // korlat felett; labirintus: hatralevo tavolsag / legrovidebb ut).
+        void set_target_gap(float gap) {
+            _target_gap = gap;
+        }
+
+        using profile_stats = typename profile_stats_of<Problem>::type;
+
+        // Generacionkent meghivodik a problema profiljaval (ha a problema
+        // gyujt ilyet, lasd reports_profile)
+        void set_stats_callback(std::function<void(int generation, profile_stats const &)> callback) {
+            _stats_callback = std::move(callback);
+        }
+
         typename Problem::population
             optimize() {
             auto pop = _problem.init_population();
@@ -107,11 +157,13 @@ namespace genetic {
                 pop = std::move(next_gen);
                 pop_fitness = _problem.evaluate(pop);
                 state.generation++;
+                check_gap(state, pop_fitness);
 
                 if (_logger != nullptr) {
                     auto p_best = _problem.find_best_in(pop);
                     (*_logger)(state.generation, p_best);
                 }
+                report_profile(state);
             }
 
             return pop;
@@ -135,6 +187,7 @@ namespace genetic {
                 pop = std::move(next_gen);
                 pop_fitness = _problem.evaluate(pop);
                 state.generation++;
+                check_gap(state, pop_fitness);
 
                 for (auto &solution : pop_fitness) {
                     if (solution.second <= target_fitness) {
@@ -147,6 +200,7 @@ namespace genetic {
                     auto p_best = _problem.find_best_in(pop);
                     (*_logger)(state.generation, p_best);
                 }
+                report_profile(state);
             }
 
             return pop;
@@ -163,6 +217,7 @@ namespace genetic {
         struct state {
             int generation = 0;
             bool stop = false;
+            float gap = NAN;
         };
 
     private:
@@ -170,10 +225,42 @@ namespace genetic {
             return state.stop || state.generation > _max_generation;
         }
 
+        void check_gap(state &state, typename Problem::evaluated_population const &pop_fitness) {
+#if __cplusplus > 201703L
+            if constexpr (reports_optimality_gap<Problem>) {
+                auto gap = _problem.optimality_gap(pop_fitness);
+                if (std::isnan(gap)) {
+                    return;
+                }
+
+                state.gap = gap;
+                if (_logger != nullptr) {
+                    printf("generation %d | optimality gap: %.3f%%\n", state.generation, 100 * gap);
+                }
+                if (gap <= _target_gap) {
+                    state.stop = true;
+                }
+            }
+#endif
+        }
+
+        void report_profile(state const &state) {
+#if __cplusplus > 201703L
+            if constexpr (reports_profile<Problem>) {
+                auto stats = _problem.take_profile();
+                if (_stats_callback) {
+                    _stats_callback(state.generation, stats);
+                }
+            }
+#endif
+        }
+
     private:
         Problem &_problem;
         int _max_generation;
         float _mutation_rate;
         Logger *_logger;
+        float _target_gap = -1;
+        std::function<void(int, profile_stats const &)> _stats_callback;
     };
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+// Forditasi ideju kapcsoloval (GP_PROFILE) bekapcsolhato profilozas a GP
+// interpreterekhez (path_finding_program, traveling_salesman_program).
+//
+// Bekapcsolva az interpreterek szamoljak a vegrehajtott muveleti kodokat,
+// a programonkenti lepesszamot (log2 hisztogramban), a lepesszam-korlatba
+// utkozott futasokat es a kiertekelesekre forditott idot. A problema ezt
+// generacionkent adja at a megoldonak (take_profile), amely a beallitott
+// statisztika-callbacknek tovabbitja (genetic::algorithm::set_stats_callback).
+//
+// Kikapcsolva a GP_PROFILE_* makrok ures utasitasok, igy az interpreterek
+// kodja ugyanaz, mint profilozas nelkul.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#if defined(GP_PROFILE)
+#define GP_PROFILING 1
+#else
+#define GP_PROFILING 0
+#endif
+
+namespace gp_profile {
+    constexpr int max_opcodes = 16;
+    // A k. vodor a [2^(k-1), 2^k) lepesszamu futasokat szamolja (a 0. a
+    // 0 lepeseseket)
+    constexpr int step_buckets = 12;
+
+    struct counters {
+        uint64_t opcodes[max_opcodes] = {};
+        uint64_t programs = 0;
+        uint64_t steps = 0;
+        uint64_t step_limit_hits = 0;
+        // A ciklusfelismeres miatt vegre nem hajtott lepesek
+        uint64_t skipped_steps = 0;
+        // A pillanatkeprol folytatott futasok at nem futtatott elotagja
+        uint64_t resumed_steps = 0;
+        uint64_t step_histogram[step_buckets] = {};
+        uint64_t evaluations = 0;
+        double evaluation_seconds = 0;
+
+        void op(int opcode, uint64_t n = 1) {
+            opcodes[opcode] += n;
+        }
+
+        void program(int n_steps, bool hit_limit) {
+            programs++;
+            steps += n_steps;
+            step_limit_hits += hit_limit;
+
+            int bucket = 0;
+            while (n_steps > 0 && bucket < step_buckets - 1) {
+                n_steps >>= 1;
+                bucket++;
+            }
+            step_histogram[bucket]++;
+        }
+
+        void print(FILE *f, char const *const *op_names, int n_opcodes) const {
+            fprintf(f, "profile | programs: %llu | avg steps: %.1f | step limit hits: %llu | skipped steps: %llu | resumed steps: %llu | evaluations: %llu (%.3f ms avg)\n",
+                (unsigned long long)programs,
+                programs > 0 ? double(steps) / programs : 0.0,
+                (unsigned long long)step_limit_hits,
+                (unsigned long long)skipped_steps,
+                (unsigned long long)resumed_steps,
+                (unsigned long long)evaluations,
+                evaluations > 0 ? 1000 * evaluation_seconds / evaluations : 0.0);
+            fprintf(f, "profile | opcodes:");
+            for (int i = 0; i < n_opcodes; i++) {
+                fprintf(f, " %s=%llu", op_names[i], (unsigned long long)opcodes[i]);
+            }
+            fprintf(f, "\nprofile | steps:");
+            for (int k = 0; k < step_buckets; k++) {
+                fprintf(f, " <%d:%llu", 1 << k, (unsigned long long)step_histogram[k]);
+            }
+            fprintf(f, "\n");
+        }
+    };
+
+    // A kiertekeles idejet meri, a megsemmisulesekor irja be
+    class evaluation_timer {
+    public:
+        evaluation_timer(counters &c) : _counters(c), _start(std::chrono::steady_clock::now()) {
+        }
+
+        ~evaluation_timer() {
+            std::chrono::duration<double> dt = std::chrono::steady_clock::now() - _start;
+            _counters.evaluation_seconds += dt.count();
+            _counters.evaluations++;
+        }
+
+    private:
+        counters &_counters;
+        std::chrono::steady_clock::time_point _start;
+    };
+}
+
+#if GP_PROFILING
+#define GP_PROFILE_OP(counters, opcode) (counters).op(int(opcode))
+#define GP_PROFILE_OPS(counters, opcode, n) (counters).op(int(opcode), uint64_t(n))
+#define GP_PROFILE_PROGRAM(counters, n_steps, hit_limit) (counters).program((n_steps), (hit_limit))
+#define GP_PROFILE_SKIPPED(counters, n) ((counters).skipped_steps += uint64_t(n))
+#define GP_PROFILE_RESUMED(counters, n) ((counters).resumed_steps += uint64_t(n))
+#define GP_PROFILE_EVALUATION(counters) gp_profile::evaluation_timer gp_profile_timer_((counters))
+#else
+#define GP_PROFILE_OP(counters, opcode) ((void)0)
+#define GP_PROFILE_OPS(counters, opcode, n) ((void)0)
+#define GP_PROFILE_PROGRAM(counters, n_steps, hit_limit) ((void)0)
+#define GP_PROFILE_SKIPPED(counters, n) ((void)0)
+#define GP_PROFILE_RESUMED(counters, n) ((void)0)
+#define GP_PROFILE_EVALUATION(counters) ((void)0)
+#endif
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+// Held-Karp (1-fa) also korlat a nyitott, rogzitett kezdopontu TSP utvonalra.
+//
+// Felveszunk egy D segedcsucsot, amely az utvonal vegpontjat koti vissza a
+// kezdopontba; a D-t erinto elek koltsege 0. Igy minden utvonal egy
+// Hamilton-kor az N + 1 csucson, amelyben D egyik szomszedja a kezdopont.
+// A D-re vett 1-fa: feszitofa a varosokon + a (D, start) el + a legolcsobb
+// masik D-bol kiindulo el. A csucsokra tett pi buntetesekkel
+//
+//   L(pi) = MST_pi + pi_start + min_{j != start} pi_j - 2 * sum(pi)
+//
+// minden pi-re also korlat; a pi-t szubgradiens iteracioval javitjuk.
+//
+// Az iteraciok alatt a feszitofat csak a jelolt eleken (k legkozelebbi
+// szomszed) szamoljuk Kruskal-lal, ami gyors, de felulbecsulheti a valodi
+// MST-t. A vegso korlatot ezert a legjobb pi-vel egyszer a teljes grafon,
+// Prim algoritmussal szamoljuk ki, igy az mindenkepp ervenyes also korlat.
+namespace held_karp {
+    namespace detail {
+        struct disjoint_set {
+            std::vector<uint32_t> parent;
+
+            disjoint_set(size_t n) : parent(n) {
+                std::iota(parent.begin(), parent.end(), 0);
+            }
+
+            uint32_t find(uint32_t x) {
+                while (parent[x] != x) {
+                    parent[x] = parent[parent[x]];
+                    x = parent[x];
+                }
+                return x;
+            }
+
+            bool join(uint32_t a, uint32_t b) {
+                a = find(a);
+                b = find(b);
+                if (a == b) {
+                    return false;
+                }
+                parent[a] = b;
+                return true;
+            }
+        };
+
+        // A (D, start) el es a legolcsobb masik D-el hozzajarulasa; `degree`-t
+        // is frissiti
+        inline double dummy_edges(std::vector<double> const &pi, size_t start, std::vector<int> *degree) {
+            auto N = pi.size();
+            size_t best = N;
+            for (size_t j = 0; j < N; j++) {
+                if (j != start && (best == N || pi[j] < pi[best])) {
+                    best = j;
+                }
+            }
+
+            if (degree != nullptr) {
+                (*degree)[start]++;
+                if (best != N) {
+                    (*degree)[best]++;
+                }
+            }
+            return pi[start] + (best != N ? pi[best] : 0);
+        }
+    }
+
+    // Also korlat a `start`-bol indulo, `N` varost bejaro nyitott utvonal
+    // hosszara.
+    //
+    // `cost(i, j)` a ket varos tavolsaga; `candidates` minden varoshoz
+    // `k` jelolt szomszedot tartalmaz (lasd traveling_salesman::candidates).
+    template<typename Cost, typename Index>
+    float path_lower_bound(
+        size_t N, size_t start, Cost const &cost,
+        std::vector<Index> const &candidates, size_t k,
+        int max_iterations = 200) {
+        if (N < 2) {
+            return 0;
+        }
+
+        // Felso korlat a lepeskozhoz: legkozelebbi szomszed heurisztika
+        double upper = 0;
+        {
+            std::vector<bool> visited(N);
+            auto cur = start;
+            visited[cur] = true;
+            for (size_t step = 1; step < N; step++) {
+                size_t best = N;
+                double best_cost = std::numeric_limits<double>::infinity();
+                for (size_t j = 0; j < N; j++) {
+                    if (!visited[j]) {
+                        double c = cost(cur, j);
+                        if (c < best_cost) {
+                            best_cost = c;
+                            best = j;
+                        }
+                    }
+                }
+                visited[best] = true;
+                upper += best_cost;
+                cur = best;
+            }
+        }
+
+        // A jelolt elek egyszer, az iteraciok alatt csak a sulyuk valtozik
+        struct edge {
+            uint32_t a, b;
+            double base;
+            double weight;
+        };
+        std::vector<edge> edges;
+        edges.reserve(N * k);
+        for (size_t i = 0; i < N; i++) {
+            for (size_t n = 0; n < k; n++) {
+                size_t j = candidates[i * k + n];
+                if (i < j) {
+                    edges.push_back({ uint32_t(i), uint32_t(j), double(cost(i, j)), 0 });
+                } else {
+                    // j -> i is jelolt-e? Ha igen, ott mar felvettuk.
+                    auto first = candidates.begin() + j * k;
+                    if (std::find(first, first + k, Index(i)) == first + k) {
+                        edges.push_back({ uint32_t(j), uint32_t(i), double(cost(i, j)), 0 });
+                    }
+                }
+            }
+        }
+
+        std::vector<double> pi(N, 0.0);
+        std::vector<double> best_pi(N, 0.0);
+        std::vector<int> degree(N);
+        double best_bound = -std::numeric_limits<double>::infinity();
+        double lambda = 2;
+        int no_improvement = 0;
+
+        for (int it = 0; it < max_iterations; it++) {
+            for (auto &e : edges) {
+                e.weight = e.base + pi[e.a] + pi[e.b];
+            }
+            std::sort(edges.begin(), edges.end(), [](edge const &lhs, edge const &rhs) { return lhs.weight < rhs.weight; });
+
+            std::fill(degree.begin(), degree.end(), 0);
+            detail::disjoint_set ds(N);
+            double tree = 0;
+            for (auto &e : edges) {
+                if (ds.join(e.a, e.b)) {
+                    tree += e.weight;
+                    degree[e.a]++;
+                    degree[e.b]++;
+                }
+            }
+            tree += detail::dummy_edges(pi, start, &degree);
+
+            double bound = tree - 2 * std::accumulate(pi.begin(), pi.end(), 0.0);
+            if (bound > best_bound) {
+                best_bound = bound;
+                best_pi = pi;
+                no_improvement = 0;
+            } else if (++no_improvement >= 10) {
+                lambda /= 2;
+                no_improvement = 0;
+            }
+
+            double norm = 0;
+            for (auto d : degree) {
+                norm += (d - 2) * (d - 2);
+            }
+            if (norm == 0) {
+                // A 1-fa egy utvonal: a korlat eles
+                break;
+            }
+
+            auto t = lambda * std::max(upper - bound, 0.0) / norm;
+            if (t < 1e-9) {
+                break;
+            }
+            for (size_t i = 0; i < N; i++) {
+                pi[i] += t * (degree[i] - 2);
+            }
+        }
+
+        // Ervenyes korlat a legjobb pi-vel: Prim a teljes grafon, O(N^2)
+        std::vector<double> key(N, std::numeric_limits<double>::infinity());
+        std::vector<bool> in_tree(N);
+        double tree = 0;
+        key[0] = 0;
+        for (size_t step = 0; step < N; step++) {
+            size_t u = N;
+            for (size_t v = 0; v < N; v++) {
+                if (!in_tree[v] && (u == N || key[v] < key[u])) {
+                    u = v;
+                }
+            }
+            in_tree[u] = true;
+            tree += key[u];
+            for (size_t v = 0; v < N; v++) {
+                if (!in_tree[v]) {
+                    auto w = cost(u, v) + best_pi[u] + best_pi[v];
+                    if (w < key[v]) {
+                        key[v] = w;
+                    }
+                }
+            }
+        }
+        tree += detail::dummy_edges(best_pi, start, nullptr);
+
+        return float(tree - 2 * std::accumulate(best_pi.begin(), best_pi.end(), 0.0));
+    }
+}
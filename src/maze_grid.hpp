@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// A maze_grid cellainak sorrendje a memoriaban.
+//
+// - row_major: soronkent; a fuggoleges lepes egy teljes sornyit ugrik, ami
+//   nagy palyan szinte mindig cache-teveszt.
+// - tiled: 8x8-as csempekben (egy csempe 64 bajt, egy cache-sor), a
+//   csempek soronkent.
+// - morton: Z-sorrend (Morton-kod) legfeljebb 256x256-os blokkokon belul,
+//   a blokkok soronkent; a blokkmeret korlatja miatt nem negyzetes palyan
+//   sem kell sokkal tobb memoria.
+enum class maze_layout {
+    row_major,
+    tiled,
+    morton,
+};
+
+// Elofeldolgozott labirintus a GP interpreterek szamara.
+//
+// A palya minden oldalon egy fal-csempevel ki van egeszitve (igy a
+// mintavetelhez nem kell hatarellenorzes), a Y tengely felfele mutat (a
+// sorok mar meg vannak forditva), es minden cella egy bajt:
+// - a 0-3. bit: van-e fal a cella mellett az adott iranyban ("wall ahead"),
+// - WALL: a cella fal,
+// - EXIT: a cella a kijarat.
+//
+// A cella indexe minden elrendezesben egy oszlop- es egy sorfuggo tag
+// osszege (index(x, y) = column[x] + row[y]), igy a ket tablazatbol
+// barmelyik elrendezesben egyszeruen szamolhato.
+//
+// Az iranyok indexei: 0 = (1, 0), 1 = (0, 1), 2 = (-1, 0), 3 = (0, -1);
+// balra fordulas +1, jobbra fordulas -1 (modulo 4).
+class maze_grid {
+public:
+    static constexpr uint8_t WALL = 1 << 4;
+    static constexpr uint8_t EXIT = 1 << 5;
+
+    maze_grid() = default;
+
+    // `tile(x, y)` a (x, y) cella WALL/EXIT bitjeit adja vissza (y felfele
+    // no)
+    template<typename Tile>
+    maze_grid(int width, int height, Tile const &tile, maze_layout layout = maze_layout::row_major)
+        : _width(width), _height(height), _stride(width + 2), _layout(layout) {
+        build_tables();
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                _cells[index(x, y)] = tile(x, y) & (WALL | EXIT);
+            }
+        }
+
+        // A "wall ahead" bitek a kiegeszitesre is: az elso lepesben a
+        // bump jelzo meg nincs kiszamolva, igy a szelen allo program
+        // kilephet a kiegeszitesre, es onnan csak visszafele lephet. A
+        // kiegeszitesen tul is fal van.
+        for (int y = -1; y <= height; y++) {
+            for (int x = -1; x <= width; x++) {
+                auto idx = index(x, y);
+                for (int dir = 0; dir < 4; dir++) {
+                    auto nx = x + direction_dx(dir);
+                    auto ny = y + direction_dy(dir);
+                    if (nx < -1 || nx > width || ny < -1 || ny > height || (_cells[index(nx, ny)] & WALL)) {
+                        _cells[idx] |= uint8_t(1 << dir);
+                    }
+                }
+            }
+        }
+    }
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    int stride() const { return _stride; }
+    maze_layout layout() const { return _layout; }
+    uint8_t const *data() const { return _cells.data(); }
+
+    int index(int x, int y) const {
+        return _column[x + 1] + _row[y + 1];
+    }
+
+    // Az index oszlop- es sorfuggo tagja, a kiegeszitett palya
+    // koordinataival (x + 1, y + 1)
+    int const *column_table() const { return _column.data(); }
+    int const *row_table() const { return _row.data(); }
+
+    // Csak soronkenti elrendezesben
+    int x_of(int idx) const {
+        assert(_layout == maze_layout::row_major);
+        return idx % _stride - 1;
+    }
+
+    // Csak soronkenti elrendezesben
+    int y_of(int idx) const {
+        assert(_layout == maze_layout::row_major);
+        return idx / _stride - 1;
+    }
+
+    uint8_t operator[](int idx) const {
+        return _cells[idx];
+    }
+
+    // Egy lepes az adott iranyba ennyivel valtoztatja a cella indexet (csak
+    // soronkenti elrendezesben)
+    int offset(int dir) const {
+        assert(_layout == maze_layout::row_major);
+        switch (dir & 3) {
+        case 0: return 1;
+        case 1: return _stride;
+        case 2: return -1;
+        default: return -_stride;
+        }
+    }
+
+    static bool wall_ahead(uint8_t cell, int dir) {
+        return (cell >> dir) & 1;
+    }
+
+    static bool is_exit(uint8_t cell) {
+        return (cell & EXIT) != 0;
+    }
+
+    static int direction(int dx, int dy) {
+        assert((dx != 0) != (dy != 0));
+        return dx != 0 ? 1 - dx : 2 - dy;
+    }
+
+    static int direction_dx(int dir) {
+        return dir == 0 ? 1 : dir == 2 ? -1 : 0;
+    }
+
+    static int direction_dy(int dir) {
+        return dir == 1 ? 1 : dir == 3 ? -1 : 0;
+    }
+
+    // Szelessegi kereses a (x, y) cellabol: a falon at nem vezeto legrovidebb
+    // ut hossza lepesekben minden cellaba (cellaindex szerint; -1, ha a
+    // cella fal vagy nem erheto el)
+    std::vector<int> distances_from(int x, int y) const {
+        std::vector<int> ret(_cells.size(), -1);
+        std::vector<std::pair<int, int>> queue;
+        queue.reserve(size_t(_width) * _height);
+
+        ret[index(x, y)] = 0;
+        queue.push_back({ x, y });
+        for (size_t head = 0; head < queue.size(); head++) {
+            auto [cx, cy] = queue[head];
+            auto idx = index(cx, cy);
+            for (int dir = 0; dir < 4; dir++) {
+                if (wall_ahead(_cells[idx], dir)) {
+                    continue;
+                }
+                auto nx = cx + direction_dx(dir);
+                auto ny = cy + direction_dy(dir);
+                auto next = index(nx, ny);
+                if (ret[next] < 0) {
+                    ret[next] = ret[idx] + 1;
+                    queue.push_back({ nx, ny });
+                }
+            }
+        }
+
+        return ret;
+    }
+
+private:
+    // A Z-sorrendhez: az also 16 bit szetteritese a paros bitekre
+    static int dilate(int v) {
+        uint32_t x = uint32_t(v) & 0xFFFF;
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+        return int(x);
+    }
+
+    void build_tables() {
+        auto padded_width = _width + 2;
+        auto padded_height = _height + 2;
+        _column.resize(padded_width);
+        _row.resize(padded_height);
+
+        size_t n_cells = 0;
+        switch (_layout) {
+        case maze_layout::row_major:
+            for (int x = 0; x < padded_width; x++) {
+                _column[x] = x;
+            }
+            for (int y = 0; y < padded_height; y++) {
+                _row[y] = y * _stride;
+            }
+            n_cells = size_t(padded_width) * padded_height;
+            break;
+        case maze_layout::tiled: {
+            constexpr int side = 8;
+            auto tiles_x = (padded_width + side - 1) / side;
+            auto tiles_y = (padded_height + side - 1) / side;
+            for (int x = 0; x < padded_width; x++) {
+                _column[x] = (x / side) * side * side + x % side;
+            }
+            for (int y = 0; y < padded_height; y++) {
+                _row[y] = (y / side) * tiles_x * side * side + (y % side) * side;
+            }
+            n_cells = size_t(tiles_x) * tiles_y * side * side;
+            break;
+        }
+        case maze_layout::morton: {
+            // A blokk oldala: a rovidebb oldalt lefedo kettohatvany, de
+            // legfeljebb 256
+            int side = 1;
+            while (side < 256 && side < std::min(padded_width, padded_height)) {
+                side *= 2;
+            }
+            auto blocks_x = (padded_width + side - 1) / side;
+            auto blocks_y = (padded_height + side - 1) / side;
+            auto block_cells = side * side;
+            for (int x = 0; x < padded_width; x++) {
+                _column[x] = (x / side) * block_cells + dilate(x % side);
+            }
+            for (int y = 0; y < padded_height; y++) {
+                _row[y] = (y / side) * blocks_x * block_cells + (dilate(y % side) << 1);
+            }
+            n_cells = size_t(blocks_x) * blocks_y * block_cells;
+            break;
+        }
+        }
+
+        _cells.assign(n_cells, WALL);
+    }
+
+private:
+    int _width = 0;
+    int _height = 0;
+    int _stride = 0;
+    maze_layout _layout = maze_layout::row_major;
+    std::vector<int> _column;
+    std::vector<int> _row;
+    std::vector<uint8_t> _cells;
+};
+
+// Pozicio a palyan soronkenti elrendezesben: a lepes egy osszeadas
+class row_major_cursor {
+public:
+    row_major_cursor(maze_grid const &grid, int x, int y) : _grid(&grid), _pos(grid.index(x, y)) {
+        for (int dir = 0; dir < 4; dir++) {
+            _offsets[dir] = grid.offset(dir);
+        }
+    }
+
+    int pos() const { return _pos; }
+    int x() const { return _grid->x_of(_pos); }
+    int y() const { return _grid->y_of(_pos); }
+
+    void step(int dir) {
+        _pos += _offsets[dir];
+    }
+
+private:
+    maze_grid const *_grid;
+    int _pos;
+    int _offsets[4];
+};
+
+// Pozicio a palyan tetszoleges elrendezesben: a koordinatakat kovetjuk, az
+// indexet a ket tablazatbol szamoljuk
+class table_cursor {
+public:
+    table_cursor(maze_grid const &grid, int x, int y)
+        : _column(grid.column_table()), _row(grid.row_table()), _x(x + 1), _y(y + 1), _pos(grid.index(x, y)) {
+    }
+
+    int pos() const { return _pos; }
+    int x() const { return _x - 1; }
+    int y() const { return _y - 1; }
+
+    void step(int dir) {
+        _x += maze_grid::direction_dx(dir);
+        _y += maze_grid::direction_dy(dir);
+        _pos = _column[_x] + _row[_y];
+    }
+
+private:
+    int const *_column;
+    int const *_row;
+    int _x, _y;
+    int _pos;
+};
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAZE_IO_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MAZE_IO_MMAP 0
+#endif
+
+#include "path_finding_program.hpp"
+
+// Labirintusok beolvasasa, kiirasa es generalasa a path_finding_program
+// szamara.
+//
+// Szoveges formatum: soronkent egy palyasor, '#' = fal, ' ' = ures,
+// 'S' = start, 'X' = kijarat. A sorvegek lehetnek LF vagy CRLF vegueek; a
+// rovidebb sorokat fallal egeszitjuk ki a leghosszabb sor szelessegere.
+//
+// Binaris formatum (little-endian):
+//   fejlec: "MAZE", u32 verzio, u32 szelesseg, u32 magassag
+//   adat:   soronkent (felulrol lefele) a csempek 2 biten (level_tile
+//           ertek), bajtonkent 4, a legalacsonyabb bitektol kezdve
+//
+// A load_level a fajl elejen levo "MAZE" alapjan donti el a formatumot. POSIX
+// rendszereken a fajlt mmap-eljuk, mashol egyetlen fread-del olvassuk be.
+namespace maze_io {
+    using level_tile = path_finding_program::level_tile;
+
+    constexpr char magic[4] = { 'M', 'A', 'Z', 'E' };
+    constexpr uint32_t version = 1;
+    constexpr size_t header_size = 16;
+    // A palya legfeljebb ekkora lehet oldalankent: a maze_grid es a
+    // szelessegi keresesek int cellaindexekkel dolgoznak
+    constexpr int max_side = 8192;
+
+    // Egy beolvasott (vagy generalt) palya; a `level()` nezete addig
+    // ervenyes, amig a maze el
+    struct maze {
+        std::vector<level_tile> tiles;
+        int width = 0;
+        int height = 0;
+
+        path_finding_program::level level() const {
+            return { tiles.data(), width, height };
+        }
+    };
+
+    namespace detail {
+        // Egy fajl teljes tartalma: mmap-elve, vagy ha az nem elerheto,
+        // beolvasva
+        class file_contents {
+        public:
+            file_contents(char const *path) {
+#if MAZE_IO_MMAP
+                auto fd = open(path, O_RDONLY);
+                if (fd < 0) {
+                    return;
+                }
+                struct stat st;
+                if (fstat(fd, &st) == 0) {
+                    _size = size_t(st.st_size);
+                    _ok = true;
+                    if (_size > 0) {
+                        auto mem = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                        if (mem == MAP_FAILED) {
+                            _ok = false;
+                        } else {
+                            _data = static_cast<char const *>(mem);
+                            _mapped = true;
+                        }
+                    }
+                }
+                close(fd);
+#else
+                auto f = fopen(path, "rb");
+                if (f == nullptr) {
+                    return;
+                }
+                fseek(f, 0, SEEK_END);
+                auto size = ftell(f);
+                fseek(f, 0, SEEK_SET);
+                if (size >= 0) {
+                    _buffer.resize(size_t(size));
+                    _size = fread(_buffer.data(), 1, _buffer.size(), f);
+                    _data = _buffer.data();
+                    _ok = _size == _buffer.size();
+                }
+                fclose(f);
+#endif
+            }
+
+            file_contents(file_contents const &) = delete;
+            file_contents &operator=(file_contents const &) = delete;
+
+            ~file_contents() {
+#if MAZE_IO_MMAP
+                if (_mapped) {
+                    munmap(const_cast<char *>(_data), _size);
+                }
+#endif
+            }
+
+            bool ok() const { return _ok; }
+            char const *data() const { return _data; }
+            size_t size() const { return _size; }
+
+        private:
+            char const *_data = nullptr;
+            size_t _size = 0;
+            bool _ok = false;
+            bool _mapped = false;
+            std::vector<char> _buffer;
+        };
+
+        inline uint32_t get_u32(char const *p) {
+            uint32_t v = 0;
+            for (int i = 0; i < 4; i++) {
+                v |= uint32_t(uint8_t(p[i])) << (8 * i);
+            }
+            return v;
+        }
+
+        inline void put_u32(FILE *f, uint32_t v) {
+            uint8_t buf[4];
+            for (int i = 0; i < 4; i++) {
+                buf[i] = uint8_t(v >> (8 * i));
+            }
+            fwrite(buf, 1, 4, f);
+        }
+
+        inline bool parse_text(char const *path, char const *data, size_t size, maze &out) {
+            // Egyetlen menet: a csempeket a vegleges szelesseg ismerete
+            // nelkul gyujtjuk, a rovid sorokat a vegen egeszitjuk ki. Az
+            // ures sor csupa fal sor; csak a fajl vegi ures sorokat hagyjuk
+            // el, ezert ezeket addig csak szamoljuk, amig nem jon utanuk
+            // nem ures sor.
+            std::vector<size_t> row_begin;
+            std::vector<int> row_width;
+            out.tiles.clear();
+            out.tiles.reserve(size);
+
+            size_t line = 1;
+            int width = 0;
+            int max_width = 0;
+            bool in_row = false;
+            size_t pending_blank = 0;
+            for (size_t i = 0; i < size; i++) {
+                auto ch = data[i];
+                level_tile tile;
+                switch (ch) {
+                case '\r':
+                    continue;
+                case '\n':
+                    if (in_row) {
+                        row_width.push_back(width);
+                        max_width = std::max(max_width, width);
+                    } else {
+                        pending_blank++;
+                    }
+                    in_row = false;
+                    width = 0;
+                    line++;
+                    continue;
+                case '#': tile = path_finding_program::TILE_WALL; break;
+                case ' ': tile = path_finding_program::TILE_EMPTY; break;
+                case 'S': tile = path_finding_program::TILE_START; break;
+                case 'X': tile = path_finding_program::TILE_EXIT; break;
+                default:
+                    fprintf(stderr, "maze_io::load_level: unknown tile '%c' in '%s' at line %zu\n", ch, path, line);
+                    return false;
+                }
+
+                if (!in_row) {
+                    for (; pending_blank > 0; pending_blank--) {
+                        row_begin.push_back(out.tiles.size());
+                        row_width.push_back(0);
+                    }
+                    row_begin.push_back(out.tiles.size());
+                    in_row = true;
+                }
+                out.tiles.push_back(tile);
+                width++;
+            }
+            if (in_row) {
+                row_width.push_back(width);
+                max_width = std::max(max_width, width);
+            }
+
+            if (row_width.empty() || max_width == 0) {
+                fprintf(stderr, "maze_io::load_level: '%s' is empty\n", path);
+                return false;
+            }
+            if (max_width > max_side || row_width.size() > size_t(max_side)) {
+                fprintf(stderr, "maze_io::load_level: '%s' is larger than %dx%d\n", path, max_side, max_side);
+                return false;
+            }
+
+            out.width = max_width;
+            out.height = int(row_width.size());
+
+            // A rovid sorok kiegeszitese (csak ha van ilyen)
+            auto all_full = std::all_of(row_width.begin(), row_width.end(), [&](int w) { return w == max_width; });
+            if (!all_full) {
+                std::vector<level_tile> tiles(size_t(out.width) * out.height, path_finding_program::TILE_WALL);
+                for (size_t r = 0; r < row_width.size(); r++) {
+                    std::copy_n(out.tiles.begin() + row_begin[r], row_width[r], tiles.begin() + r * out.width);
+                }
+                out.tiles = std::move(tiles);
+            }
+
+            return true;
+        }
+
+        inline bool parse_binary(char const *path, char const *data, size_t size, maze &out) {
+            if (size < header_size || get_u32(data + 4) != version) {
+                fprintf(stderr, "maze_io::load_level: '%s' is not a supported maze file\n", path);
+                return false;
+            }
+
+            auto width = get_u32(data + 8);
+            auto height = get_u32(data + 12);
+            auto n_tiles = uint64_t(width) * height;
+            if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX || (size - header_size) < (n_tiles + 3) / 4) {
+                fprintf(stderr, "maze_io::load_level: '%s' is truncated or corrupt\n", path);
+                return false;
+            }
+            if (width > uint32_t(max_side) || height > uint32_t(max_side)) {
+                fprintf(stderr, "maze_io::load_level: '%s' is larger than %dx%d\n", path, max_side, max_side);
+                return false;
+            }
+
+            out.width = int(width);
+            out.height = int(height);
+            out.tiles.resize(n_tiles);
+            auto packed = reinterpret_cast<uint8_t const *>(data + header_size);
+            for (uint64_t i = 0; i < n_tiles; i++) {
+                out.tiles[i] = level_tile((packed[i / 4] >> (2 * (i % 4))) & 3);
+            }
+
+            return true;
+        }
+    }
+
+    // Beolvas egy szoveges vagy binaris palyat
+    inline bool load_level(char const *path, maze &out) {
+        detail::file_contents file(path);
+        if (!file.ok()) {
+            fprintf(stderr, "maze_io::load_level: failed to open '%s' for reading\n", path);
+            return false;
+        }
+
+        if (file.size() >= 4 && memcmp(file.data(), magic, 4) == 0) {
+            return detail::parse_binary(path, file.data(), file.size(), out);
+        }
+        return detail::parse_text(path, file.data(), file.size(), out);
+    }
+
+    inline bool save_level_text(char const *path, maze const &m) {
+        auto f = fopen(path, "wb");
+        if (f == nullptr) {
+            fprintf(stderr, "maze_io::save_level_text: failed to open '%s' for writing\n", path);
+            return false;
+        }
+
+        static char const chars[] = { '#', ' ', 'S', 'X' };
+        std::vector<char> row(size_t(m.width) + 1, '\n');
+        for (int y = 0; y < m.height; y++) {
+            for (int x = 0; x < m.width; x++) {
+                row[x] = chars[m.tiles[size_t(y) * m.width + x]];
+            }
+            fwrite(row.data(), 1, row.size(), f);
+        }
+
+        fclose(f);
+        return true;
+    }
+
+    inline bool save_level_binary(char const *path, maze const &m) {
+        auto f = fopen(path, "wb");
+        if (f == nullptr) {
+            fprintf(stderr, "maze_io::save_level_binary: failed to open '%s' for writing\n", path);
+            return false;
+        }
+
+        fwrite(magic, 1, 4, f);
+        detail::put_u32(f, version);
+        detail::put_u32(f, uint32_t(m.width));
+        detail::put_u32(f, uint32_t(m.height));
+
+        std::vector<uint8_t> packed((m.tiles.size() + 3) / 4, 0);
+        for (size_t i = 0; i < m.tiles.size(); i++) {
+            packed[i / 4] |= uint8_t(m.tiles[i] << (2 * (i % 4)));
+        }
+        fwrite(packed.data(), 1, packed.size(), f);
+
+        fclose(f);
+        return true;
+    }
+
+    // A generalt labirintus jellemzoi
+    struct generator_options {
+        // Ennyi veletlen (legfeljebb max_room_size oldalu) teglalap alaku
+        // termet vagunk ki a folyosok koze (0 = tokeletes labirintus)
+        int rooms = 0;
+        int max_room_size = 8;
+    };
+
+    // Seedelt labirintusgenerator (iterativ recursive backtracker). A
+    // folyosok a paratlan koordinataju cellakon futnak, igy a legkisebb
+    // meret 5x3; paros meretnel az utolso sor/oszlop fal marad. A
+    // start a bal felso cella, a kijarat a starttol (lepesben) legtavolabbi
+    // cella. A meret legfeljebb max_side oldalankent.
+    inline maze generate(int width, int height, uint64_t seed, generator_options const &options = {}) {
+        assert(width <= max_side && height <= max_side);
+        maze ret;
+        ret.width = std::max(width, 5);
+        ret.height = std::max(height, 3);
+        ret.tiles.assign(size_t(ret.width) * ret.height, path_finding_program::TILE_WALL);
+
+        std::mt19937_64 rng(seed);
+        auto at = [&](int x, int y) -> level_tile & {
+            return ret.tiles[size_t(y) * ret.width + x];
+        };
+
+        // A cellak a (2i + 1, 2j + 1) koordinatakon vannak
+        auto cells_x = (ret.width - 1) / 2;
+        auto cells_y = (ret.height - 1) / 2;
+        static int const dirs[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+        std::vector<std::pair<int, int>> stack;
+        at(1, 1) = path_finding_program::TILE_EMPTY;
+        stack.push_back({ 0, 0 });
+        while (!stack.empty()) {
+            auto [cx, cy] = stack.back();
+
+            int candidates[4];
+            int n_candidates = 0;
+            for (int d = 0; d < 4; d++) {
+                auto nx = cx + dirs[d][0];
+                auto ny = cy + dirs[d][1];
+                if (nx >= 0 && nx < cells_x && ny >= 0 && ny < cells_y && at(2 * nx + 1, 2 * ny + 1) == path_finding_program::TILE_WALL) {
+                    candidates[n_candidates++] = d;
+                }
+            }
+
+            if (n_candidates == 0) {
+                stack.pop_back();
+                continue;
+            }
+
+            auto d = candidates[std::uniform_int_distribution(0, n_candidates - 1)(rng)];
+            at(2 * cx + 1 + dirs[d][0], 2 * cy + 1 + dirs[d][1]) = path_finding_program::TILE_EMPTY;
+            at(2 * (cx + dirs[d][0]) + 1, 2 * (cy + dirs[d][1]) + 1) = path_finding_program::TILE_EMPTY;
+            stack.push_back({ cx + dirs[d][0], cy + dirs[d][1] });
+        }
+
+        // Termek: a keret belsejeben
+        for (int r = 0; r < options.rooms && ret.width > 4 && ret.height > 4; r++) {
+            auto max_size = std::max(1, options.max_room_size);
+            auto w = std::uniform_int_distribution(1, std::min(max_size, ret.width - 2))(rng);
+            auto h = std::uniform_int_distribution(1, std::min(max_size, ret.height - 2))(rng);
+            auto x0 = std::uniform_int_distribution(1, ret.width - 1 - w)(rng);
+            auto y0 = std::uniform_int_distribution(1, ret.height - 1 - h)(rng);
+            for (int y = y0; y < y0 + h; y++) {
+                for (int x = x0; x < x0 + w; x++) {
+                    at(x, y) = path_finding_program::TILE_EMPTY;
+                }
+            }
+        }
+
+        // Kijarat: a starttol legtavolabbi cella (szelessegi keresessel)
+        std::vector<int> dist(ret.tiles.size(), -1);
+        std::vector<int> queue;
+        queue.reserve(ret.tiles.size());
+        auto start = ret.width + 1;
+        dist[start] = 0;
+        queue.push_back(start);
+        auto farthest = start;
+        for (size_t head = 0; head < queue.size(); head++) {
+            auto idx = queue[head];
+            if (dist[idx] > dist[farthest]) {
+                farthest = idx;
+            }
+            int const offsets[4] = { 1, -1, ret.width, -ret.width };
+            for (auto off : offsets) {
+                auto next = idx + off;
+                if (dist[next] < 0 && ret.tiles[next] != path_finding_program::TILE_WALL) {
+                    dist[next] = dist[idx] + 1;
+                    queue.push_back(next);
+                }
+            }
+        }
+
+        ret.tiles[start] = path_finding_program::TILE_START;
+        ret.tiles[farthest] = path_finding_program::TILE_EXIT;
+        return ret;
+    }
+}
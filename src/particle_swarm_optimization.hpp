@@ -1,21 +1,32 @@
 #pragma once
 
+#include <cmath>
+#include <cstdio>
 #include <vector>
 #include <random>
 #include <functional>
 
+#include "particle_swarm_soa.hpp"
+#include "particle_swarm_topology.hpp"
+#include "thread_pool.hpp"
+
 namespace pso {
 	template<typename P, typename V>
 	struct particle {
 		P position;
 		V velocity;
 		P optima;
+		// A jelenlegi pozicio es a szemelyes optimum fitnesse (a solver
+		// tolti ki)
+		float fitness = INFINITY;
+		float optima_fitness = INFINITY;
 	};
 
 	template<typename P, typename V>
 	struct swarm {
 		std::vector<particle<P, V>> particles;
 		P optima;
+		float optima_fitness = INFINITY;
 	};
 
 #if __cplusplus > 201703L
@@ -68,6 +79,15 @@ namespace pso {
 #define particle_swarm_optimizable typename
 #endif
 
+	// A raj tarolasa a solver-ben
+	enum class backend {
+		// A Problem tipusaival, reszecskenkent (particle, swarm)
+		aos,
+		// Dimenziokent folytonos tombokben, vektorizalt iteracioval (lasd
+		// soa_swarm)
+		soa,
+	};
+
 	struct params {
 		size_t max_iterations;
 
@@ -75,6 +95,24 @@ namespace pso {
 		
 		float phi_p;
 		float phi_g;
+
+		pso::backend backend;
+		// A soa backend ennyi szalon fut (0 = ahany hardveres szal van);
+		// tobb szalon a Problem::evaluate_fitness-nek szalbiztosnak kell
+		// lennie. Szinkron frissitessel az eredmeny nem fugg a szalak
+		// szamatol.
+		unsigned n_threads;
+
+		// A szomszedsagi topologia es parametere (0 = alapertelmezes, lasd
+		// pso::topology); a lokalis topologiak csak a soa backenddel
+		pso::topology topology;
+		size_t neighbors;
+		// Aszinkron frissites (csak a soa backenddel): nincs iteracionkenti
+		// szinkronizacio, a szalak a sajat reszecskeiket leptetik, es a
+		// szomszedok optimumait mindig a legfrissebb kozzetett allapotbol
+		// olvassak. Tobb szalon az eredmeny fugg az utemezestol; a logger
+		// csak a futas vegen kap egy hivast.
+		bool asynchronous;
 	};
 
 	template<particle_swarm_optimizable Problem>
@@ -94,11 +132,20 @@ namespace pso {
 
 		solver(
 			Problem &problem,
-			params const &params) : _problem(problem), _params(params) {
+			params const &params) : _problem(problem), _params(params),
+			_pool(params.backend == backend::soa ? params.n_threads : 1) {
 		}
 
 		position_t solve(size_t num_particles, logger *logger) {
+			if (_params.backend == backend::soa) {
+				return solve_soa(num_particles, logger);
+			}
+			if (_params.topology != topology::global || _params.asynchronous) {
+				fprintf(stderr, "pso::solver::solve: local topologies and asynchronous updates need the soa backend; using a global, synchronous swarm\n");
+			}
+
 			auto swarm = swarm_t{ _problem.generate_swarm(num_particles) };
+			evaluate_initial(swarm);
 
 			size_t current_iteration = 0;
 
@@ -118,9 +165,215 @@ namespace pso {
 		}
 
 	protected:
+		// Ugyanaz az iteracio, mint a solve-ban, SoA tarolassal.
+		//
+		// A raj soa_chunk reszecskes darabokban frissul es ertekelodik ki, a
+		// darabok a szalkeszleten oszlanak szet. Minden darabnak sajat
+		// veletlenszam-folyama van, es a globalis optimumot az iteracio
+		// vegen egy zarolas nelkuli minimumkeresesbol (fitness, index)
+		// frissitjuk, ami ugyanazt adja, mint a soros bejaras; igy az
+		// eredmeny nem fugg a szalak szamatol es az utemezestol.
+		//
+		// Lokalis topologiaban a frissites elott egy kulon menetben minden
+		// reszecske a szomszedai legjobb optimumat a guide() sorokba masolja
+		// (a frissites kozben a szomszedok optimumai mar valtozhatnak).
+		// Aszinkron frissiteshez lasd iterate_asynchronous.
+		position_t solve_soa(size_t num_particles, logger *logger) {
+			auto particles = _problem.generate_swarm(num_particles);
+			if (particles.empty()) {
+				return {};
+			}
+
+			// A poziciok a Problem tipusaban: kiertekeleshez es az eredmenyhez
+			auto position = particles[0].position;
+			soa_swarm swarm(particles.size(), position.size());
+			for (size_t i = 0; i < particles.size(); i++) {
+				swarm.store(i, particles[i]);
+			}
+
+			// A kezdeti szemelyes optimumok (lasd evaluate_initial)
+			for (size_t i = 0; i < swarm.size(); i++) {
+				swarm.optima_fitness(i) = _problem.evaluate_fitness(particles[i].optima);
+				if (swarm.optima_fitness(i) < swarm.global_fitness()) {
+					swarm.update_global(i);
+				}
+			}
+
+			auto n_chunks = (swarm.stride() + soa_chunk - 1) / soa_chunk;
+			std::vector<bulk_random> streams;
+			auto seed = uint64_t(_rand());
+			for (size_t c = 0; c < n_chunks; c++) {
+				streams.emplace_back(seed + c);
+			}
+
+			auto local = _params.topology != topology::global;
+			neighborhood hood;
+			if (local) {
+				hood = neighborhood(_params.topology, swarm.size(), _params.neighbors, uint64_t(_rand()));
+			}
+
+			if (_params.asynchronous) {
+				iterate_asynchronous(swarm, streams, hood, position);
+
+				if (logger != nullptr && _params.max_iterations > 0) {
+					logger->on_iteration_done(_params.max_iterations - 1, swarm.global_fitness());
+					for (size_t i = 0; i < swarm.size(); i++) {
+						swarm.load(i, particles[i]);
+						logger->on_next_state(_params.max_iterations - 1, i, swarm.fitness(i), particles[i]);
+					}
+				}
+			} else {
+				size_t current_iteration = 0;
+
+				while (current_iteration < _params.max_iterations) {
+					if (local) {
+						_pool.parallel_for(n_chunks, 1, [&](size_t c_begin, size_t c_end, unsigned) {
+							for (auto i = c_begin * soa_chunk; i < std::min(c_end * soa_chunk, swarm.size()); i++) {
+								auto j = best_neighbor(hood, i, [&](size_t k) { return swarm.optima_fitness(k); });
+								for (size_t d = 0; d < swarm.dimensions(); d++) {
+									swarm.guide(d)[i] = swarm.optima(d)[j];
+								}
+							}
+						});
+					}
+
+					// A szemelyes optimumat javito reszecskek kozul a legjobb
+					std::atomic<uint64_t> best = UINT64_MAX;
+
+					_pool.parallel_for(n_chunks, 1, [&](size_t c_begin, size_t c_end, unsigned) {
+						auto chunk_position = position;
+						for (auto c = c_begin; c < c_end; c++) {
+							auto begin = c * soa_chunk;
+							auto end = std::min(begin + soa_chunk, swarm.stride());
+							swarm.update(begin, end, _params.omega, _params.phi_p, _params.phi_g, 1.0f, streams[c], local);
+
+							auto chunk_best = UINT64_MAX;
+							for (auto i = begin; i < std::min(end, swarm.size()); i++) {
+								swarm.load_position(i, chunk_position);
+								auto f = _problem.evaluate_fitness(chunk_position);
+								swarm.fitness(i) = f;
+
+								if (f < swarm.optima_fitness(i)) {
+									swarm.update_optima(i);
+									chunk_best = std::min(chunk_best, fitness_key(f, i));
+								}
+							}
+							atomic_min(best, chunk_best);
+						}
+					});
+
+					if (best != UINT64_MAX) {
+						auto i = fitness_key_index(best);
+						if (swarm.optima_fitness(i) < swarm.global_fitness()) {
+							swarm.update_global(i);
+						}
+					}
+
+					if (logger != nullptr) {
+						logger->on_iteration_done(current_iteration, swarm.global_fitness());
+
+						for (size_t i = 0; i < swarm.size(); i++) {
+							swarm.load(i, particles[i]);
+							logger->on_next_state(current_iteration, i, swarm.fitness(i), particles[i]);
+						}
+					}
+
+					current_iteration++;
+				}
+			}
+
+			for (size_t d = 0; d < swarm.dimensions(); d++) {
+				position[d] = swarm.global()[d];
+			}
+			return position;
+		}
+
+		// A szomszedok kozul a legjobb szemelyes optimumu indexe
+		// (egyenloseg eseten az elso a listaban)
+		template<typename Fitness>
+		static size_t best_neighbor(neighborhood const &hood, size_t i, Fitness const &fitness) {
+			auto best = *hood.begin(i);
+			auto best_fitness = fitness(best);
+			for (auto it = hood.begin(i) + 1; it != hood.end(i); it++) {
+				auto f = fitness(*it);
+				if (f < best_fitness) {
+					best = *it;
+					best_fitness = f;
+				}
+			}
+			return best;
+		}
+
+		// A solve_soa iteracioi aszinkron frissitessel.
+		//
+		// A darabokat a szalak kozott egyszer osztjuk szet (a g. csoport a
+		// g, g + n_groups, ... darabok), es minden csoport a sajat darabjain
+		// vegzi el az osszes iteraciot, a tobbiekre valo varakozas nelkul. A
+		// szemelyes optimumok javulaskor azonnal megjelennek a
+		// published_bests-ben, a reszecskek a frissitesuk elott innen
+		// olvassak a kovetett optimumot: lokalis topologiaban a szomszedok
+		// kozul a legjobbat, globalisban az eddigi legjobb reszecsket,
+		// amelyet egy zarolas nelkuli minimum (fitness, index) kulcs jelol.
+		void iterate_asynchronous(soa_swarm &swarm, std::vector<bulk_random> &streams, neighborhood const &hood, position_t const &position) {
+			auto n_chunks = streams.size();
+			auto local = _params.topology != topology::global;
+
+			published_bests published(swarm.size(), swarm.dimensions());
+			std::atomic<uint64_t> best = UINT64_MAX;
+			for (size_t i = 0; i < swarm.size(); i++) {
+				published.publish(i, swarm);
+				atomic_min(best, fitness_key(swarm.optima_fitness(i), i));
+			}
+
+			auto n_groups = std::min(size_t(_pool.size()), n_chunks);
+			_pool.parallel_for(n_groups, 1, [&](size_t g_begin, size_t g_end, unsigned) {
+				auto chunk_position = position;
+				std::vector<float> guide(swarm.dimensions());
+
+				for (auto g = g_begin; g < g_end; g++) {
+					for (size_t iteration = 0; iteration < _params.max_iterations; iteration++) {
+						for (auto c = g; c < n_chunks; c += n_groups) {
+							auto begin = c * soa_chunk;
+							auto end = std::min(begin + soa_chunk, swarm.stride());
+							auto last = std::min(end, swarm.size());
+
+							if (!local) {
+								published.read(fitness_key_index(best.load(std::memory_order_relaxed)), guide.data());
+							}
+							for (auto i = begin; i < last; i++) {
+								if (local) {
+									auto j = best_neighbor(hood, i, [&](size_t k) { return published.fitness(k); });
+									published.read(j, guide.data());
+								}
+								for (size_t d = 0; d < swarm.dimensions(); d++) {
+									swarm.guide(d)[i] = guide[d];
+								}
+							}
+
+							swarm.update(begin, end, _params.omega, _params.phi_p, _params.phi_g, 1.0f, streams[c], true);
+
+							for (auto i = begin; i < last; i++) {
+								swarm.load_position(i, chunk_position);
+								auto f = _problem.evaluate_fitness(chunk_position);
+								swarm.fitness(i) = f;
+
+								if (f < swarm.optima_fitness(i)) {
+									swarm.update_optima(i);
+									published.publish(i, swarm);
+									atomic_min(best, fitness_key(f, i));
+								}
+							}
+						}
+					}
+				}
+			});
+
+			swarm.update_global(fitness_key_index(best));
+		}
+
 		velocity_t calculate_velocity(swarm_t const &s, particle_t const &p) {
 			std::uniform_real_distribution<float> dist(0, 1);
-			auto rnd = std::bind(dist, _rand);
+			auto rnd = [&]() { return dist(_rand); };
 			
 			velocity_t ret = {};
 
@@ -152,28 +405,42 @@ namespace pso {
 			}
 		}
 
+		// A fitness-eket az evaluate_all mar kiszamolta
 		void log(logger *logger, size_t gen, swarm_t const &swarm) {
-			logger->on_iteration_done(gen, _problem.evaluate_fitness(swarm.optima));
+			logger->on_iteration_done(gen, swarm.optima_fitness);
 			
 			for (size_t i = 0; i < swarm.particles.size(); i++) {
 				auto &particle = swarm.particles[i];
-				auto f = _problem.evaluate_fitness(particle.position);
-				logger->on_next_state(gen, i, f, particle);
+				logger->on_next_state(gen, i, particle.fitness, particle);
 			}
 		}
 
-		void evaluate_all(swarm_t &swarm) {
-			float g_opt = _problem.evaluate_fitness(swarm.optima);
+		// A kezdeti szemelyes optimumok kiertekelese; a globalis optimum
+		// ezek kozul a legjobb
+		void evaluate_initial(swarm_t &swarm) {
+			for (auto &particle : swarm.particles) {
+				particle.optima_fitness = _problem.evaluate_fitness(particle.optima);
 
+				if (particle.optima_fitness < swarm.optima_fitness) {
+					swarm.optima_fitness = particle.optima_fitness;
+					swarm.optima = particle.optima;
+				}
+			}
+		}
+
+		// Reszecskenkent egy kiertekeles: az optimumok fitnesset eltaroljuk,
+		// es csak javulaskor frissitjuk
+		void evaluate_all(swarm_t &swarm) {
 			for (auto &particle : swarm.particles) {
-				auto f_opt = _problem.evaluate_fitness(particle.optima);
 				auto f = _problem.evaluate_fitness(particle.position);
+				particle.fitness = f;
 
-				if (f < f_opt) {
+				if (f < particle.optima_fitness) {
 					particle.optima = particle.position;
+					particle.optima_fitness = f;
 
-					if (f_opt < g_opt) {
-						g_opt = f_opt;
+					if (f < swarm.optima_fitness) {
+						swarm.optima_fitness = f;
 						swarm.optima = particle.optima;
 					}
 				}
@@ -181,8 +448,13 @@ namespace pso {
 		}
 
 	private:
+		// A soa backend darabmerete (az igazitas tobbszorose)
+		static constexpr size_t soa_chunk = 64;
+		static_assert(soa_chunk % soa_swarm::alignment == 0);
+
 		Problem &_problem;
 		params const _params;
 		std::mt19937 _rand;
+		thread_pool _pool;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,369 @@
+#pragma once
+
+// A PSO raj SoA ("structure of arrays") tarolasa es az iteracio
+// vektorizalt magja.
+//
+// A raj minden mennyisege (pozicio, sebesseg, szemelyes optimum, a lokalis
+// topologiakban kovetett szomszedos optimum)
+// dimenziokent egy-egy folytonos, 64 bajtra igazitott sor, amelyben a
+// reszecskek egymas utan kovetkeznek; a sebesseg- es pozicio-frissites
+// igy dimenziokent egyetlen, a teljes rajon vegigmeno ciklus. A ciklushoz
+// szukseges veletlenszamokat (dimenziokent reszecskenkent kettot) egy
+// tombben, elore generaljuk. A frissites a raj egy igazitott
+// reszecsketartomanyara is kerheto, igy a raj darabjai kulon szalakon,
+// kulon veletlenszam-folyammal frissithetok.
+//
+// Ha a fordito AVX-512 vagy AVX2 utasitasokat generalhat (pl. -march=native,
+// lasd a NATIVE_ARCH CMake kapcsolot), a mag ezekkel fut, kulonben sima C++
+// ciklus.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace pso {
+	// Sok [0, 1) egyenletes eloszlasu float egyszerre: `lanes` darab
+	// fuggetlen xoshiro128+ generator, amelyeket egy ciklusban leptetunk
+	// (a ciklus a fordito altal vektorizalhato)
+	class bulk_random {
+	public:
+		static constexpr size_t lanes = 16;
+
+		explicit bulk_random(uint64_t seed) {
+			// A savok allapota splitmix64-bol
+			for (size_t l = 0; l < lanes; l++) {
+				for (int k = 0; k < 4; k++) {
+					seed += 0x9E3779B97F4A7C15ull;
+					uint64_t z = seed;
+					z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+					z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+					z ^= z >> 31;
+					_state[k][l] = uint32_t(z >> 32) | 1;
+				}
+			}
+		}
+
+		void fill(float *out, size_t count) {
+			// Az allapot helyi masolaton: igy a fordito a teljes ciklus alatt
+			// regiszterekben tarthatja, es nem kell a kimenettel valo
+			// atfedestol tartania
+			alignas(64) uint32_t s[4][lanes];
+			std::memcpy(s, _state, sizeof(s));
+
+			size_t i = 0;
+			for (; i + lanes <= count; i += lanes) {
+				next(s, out + i);
+			}
+			if (i < count) {
+				float rest[lanes];
+				next(s, rest);
+				for (size_t l = 0; i < count; l++, i++) {
+					out[i] = rest[l];
+				}
+			}
+
+			std::memcpy(_state, s, sizeof(s));
+		}
+
+	private:
+		static void next(uint32_t (&s)[4][lanes], float *out) {
+			for (size_t l = 0; l < lanes; l++) {
+				uint32_t result = s[0][l] + s[3][l];
+				uint32_t t = s[1][l] << 9;
+				s[2][l] ^= s[0][l];
+				s[3][l] ^= s[1][l];
+				s[1][l] ^= s[2][l];
+				s[0][l] ^= s[3][l];
+				s[2][l] ^= t;
+				s[3][l] = (s[3][l] << 11) | (s[3][l] >> 21);
+				// A felso 24 bit a mantisszaba
+				out[l] = float(result >> 8) * (1.0f / 16777216.0f);
+			}
+		}
+
+	private:
+		alignas(64) uint32_t _state[4][lanes];
+	};
+
+	// Fitness es reszecskeindex egy rendezheto kulcsban: a kisebb kulcs a
+	// kisebb fitness, egyenloseg eseten a kisebb index
+	inline uint64_t fitness_key(float fitness, size_t index) {
+		uint32_t bits;
+		std::memcpy(&bits, &fitness, sizeof(bits));
+		bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+		return (uint64_t(bits) << 32) | uint32_t(index);
+	}
+
+	inline size_t fitness_key_index(uint64_t key) {
+		return size_t(uint32_t(key));
+	}
+
+	// Zarolas nelkuli minimum: `target` = min(`target`, `key`)
+	inline void atomic_min(std::atomic<uint64_t> &target, uint64_t key) {
+		auto current = target.load(std::memory_order_relaxed);
+		while (key < current && !target.compare_exchange_weak(current, key, std::memory_order_relaxed)) {
+		}
+	}
+
+	class soa_swarm {
+	public:
+		// A sorok hossza ennek a tobbszorose (64 bajt)
+		static constexpr size_t alignment = 16;
+
+		soa_swarm(size_t n_particles, size_t dimensions)
+			: _size(n_particles), _dimensions(dimensions),
+			_stride((n_particles + alignment - 1) / alignment * alignment),
+			_fitness(n_particles, INFINITY), _optima_fitness(n_particles, INFINITY),
+			_global(dimensions, 0.0f) {
+			// Pozicio, sebesseg, szemelyes optimum, kovetett optimum es a ket
+			// veletlen sor
+			_storage.assign(4 * dimensions * _stride + 2 * _stride + alignment, 0.0f);
+			auto misalignment = reinterpret_cast<uintptr_t>(_storage.data()) % (alignment * sizeof(float));
+			_base = _storage.data() + (misalignment == 0 ? 0 : alignment - misalignment / sizeof(float));
+		}
+
+		soa_swarm(soa_swarm const &) = delete;
+		soa_swarm &operator=(soa_swarm const &) = delete;
+
+		size_t size() const { return _size; }
+		size_t dimensions() const { return _dimensions; }
+		size_t stride() const { return _stride; }
+
+		// Az adott dimenzio sora (stride() hosszu; a size() utani elemek
+		// kitoltesek)
+		float *position(size_t d) { return _base + d * _stride; }
+		float *velocity(size_t d) { return _base + (_dimensions + d) * _stride; }
+		float *optima(size_t d) { return _base + (2 * _dimensions + d) * _stride; }
+		float const *position(size_t d) const { return _base + d * _stride; }
+		float const *velocity(size_t d) const { return _base + (_dimensions + d) * _stride; }
+		float const *optima(size_t d) const { return _base + (2 * _dimensions + d) * _stride; }
+		// Lokalis topologiaban a reszecske altal kovetett optimum (a
+		// globalis optimum helyett, lasd update)
+		float *guide(size_t d) { return _base + (3 * _dimensions + d) * _stride; }
+		float const *guide(size_t d) const { return _base + (3 * _dimensions + d) * _stride; }
+
+		// A jelenlegi pozicio es a szemelyes optimum fitnesse
+		float &fitness(size_t i) { return _fitness[i]; }
+		float &optima_fitness(size_t i) { return _optima_fitness[i]; }
+		float fitness(size_t i) const { return _fitness[i]; }
+		float optima_fitness(size_t i) const { return _optima_fitness[i]; }
+
+		// A globalis optimum
+		float *global() { return _global.data(); }
+		float const *global() const { return _global.data(); }
+		float &global_fitness() { return _global_fitness; }
+		float global_fitness() const { return _global_fitness; }
+
+		template<typename Particle>
+		void store(size_t i, Particle const &p) {
+			for (size_t d = 0; d < _dimensions; d++) {
+				position(d)[i] = p.position[d];
+				velocity(d)[i] = p.velocity[d];
+				optima(d)[i] = p.optima[d];
+			}
+		}
+
+		template<typename Particle>
+		void load(size_t i, Particle &p) const {
+			load_position(i, p.position);
+			for (size_t d = 0; d < _dimensions; d++) {
+				p.velocity[d] = velocity(d)[i];
+				p.optima[d] = optima(d)[i];
+			}
+			p.fitness = _fitness[i];
+			p.optima_fitness = _optima_fitness[i];
+		}
+
+		template<typename Position>
+		void load_position(size_t i, Position &p) const {
+			for (size_t d = 0; d < _dimensions; d++) {
+				p[d] = position(d)[i];
+			}
+		}
+
+		// A reszecske jelenlegi pozicioja lesz a szemelyes optimuma
+		void update_optima(size_t i) {
+			for (size_t d = 0; d < _dimensions; d++) {
+				optima(d)[i] = position(d)[i];
+			}
+			_optima_fitness[i] = _fitness[i];
+		}
+
+		// A reszecske szemelyes optimuma lesz a globalis optimum
+		void update_global(size_t i) {
+			for (size_t d = 0; d < _dimensions; d++) {
+				_global[d] = optima(d)[i];
+			}
+			_global_fitness = _optima_fitness[i];
+		}
+
+		// Sebesseg- es pozicio-frissites a [begin, end) reszecskeken:
+		//   v = omega * v + phi_p * r_p * (p - x) + phi_g * r_g * (g - x)
+		//   x = x + step * v
+		// ahol r_p es r_g reszecskenkent es dimenziokent uj veletlenszam a
+		// `rand`-bol, g pedig a globalis optimum, vagy `use_guide` eseten a
+		// reszecske guide() sorokba irt optimuma. A `begin` es az `end` az
+		// alignment tobbszorose (az `end` legfeljebb stride()); diszjunkt
+		// tartomanyok parhuzamosan is frissithetok.
+		void update(size_t begin, size_t end, float omega, float phi_p, float phi_g, float step, bulk_random &rand, bool use_guide = false) {
+			auto n = end - begin;
+			auto r_p = _base + 4 * _dimensions * _stride + begin;
+			auto r_g = r_p + _stride;
+			for (size_t d = 0; d < _dimensions; d++) {
+				rand.fill(r_p, n);
+				rand.fill(r_g, n);
+				if (use_guide) {
+					update_row<true>(position(d) + begin, velocity(d) + begin, optima(d) + begin, guide(d) + begin, 0.0f, r_p, r_g, n, omega, phi_p, phi_g, step);
+				} else {
+					update_row<false>(position(d) + begin, velocity(d) + begin, optima(d) + begin, nullptr, _global[d], r_p, r_g, n, omega, phi_p, phi_g, step);
+				}
+			}
+		}
+
+	private:
+		// Egy dimenzio sora; `n` az alignment tobbszorose, a tombok
+		// 64 bajtra igazitottak. GuideRow eseten a kovetett optimum a
+		// `g_row` sor, kulonben mindenkinek `g`.
+		template<bool GuideRow>
+		static void update_row(
+			float *x, float *v, float const *p, float const *g_row, float g, float const *r_p, float const *r_g, size_t n,
+			float omega, float phi_p, float phi_g, float step) {
+#if defined(__AVX512F__)
+			auto omega_ = _mm512_set1_ps(omega);
+			auto phi_p_ = _mm512_set1_ps(phi_p);
+			auto phi_g_ = _mm512_set1_ps(phi_g);
+			auto step_ = _mm512_set1_ps(step);
+			auto g_ = _mm512_set1_ps(g);
+			for (size_t i = 0; i < n; i += 16) {
+				auto gi = g_;
+				if constexpr (GuideRow) {
+					gi = _mm512_load_ps(g_row + i);
+				}
+				auto xi = _mm512_load_ps(x + i);
+				auto vi = _mm512_mul_ps(omega_, _mm512_load_ps(v + i));
+				auto cp = _mm512_mul_ps(phi_p_, _mm512_load_ps(r_p + i));
+				auto cg = _mm512_mul_ps(phi_g_, _mm512_load_ps(r_g + i));
+				vi = _mm512_fmadd_ps(cp, _mm512_sub_ps(_mm512_load_ps(p + i), xi), vi);
+				vi = _mm512_fmadd_ps(cg, _mm512_sub_ps(gi, xi), vi);
+				_mm512_store_ps(v + i, vi);
+				_mm512_store_ps(x + i, _mm512_fmadd_ps(step_, vi, xi));
+			}
+#elif defined(__AVX2__)
+			auto omega_ = _mm256_set1_ps(omega);
+			auto phi_p_ = _mm256_set1_ps(phi_p);
+			auto phi_g_ = _mm256_set1_ps(phi_g);
+			auto step_ = _mm256_set1_ps(step);
+			auto g_ = _mm256_set1_ps(g);
+			for (size_t i = 0; i < n; i += 8) {
+				auto gi = g_;
+				if constexpr (GuideRow) {
+					gi = _mm256_load_ps(g_row + i);
+				}
+				auto xi = _mm256_load_ps(x + i);
+				auto vi = _mm256_mul_ps(omega_, _mm256_load_ps(v + i));
+				auto cp = _mm256_mul_ps(phi_p_, _mm256_load_ps(r_p + i));
+				auto cg = _mm256_mul_ps(phi_g_, _mm256_load_ps(r_g + i));
+#if defined(__FMA__)
+				vi = _mm256_fmadd_ps(cp, _mm256_sub_ps(_mm256_load_ps(p + i), xi), vi);
+				vi = _mm256_fmadd_ps(cg, _mm256_sub_ps(gi, xi), vi);
+				_mm256_store_ps(v + i, vi);
+				_mm256_store_ps(x + i, _mm256_fmadd_ps(step_, vi, xi));
+#else
+				vi = _mm256_add_ps(vi, _mm256_mul_ps(cp, _mm256_sub_ps(_mm256_load_ps(p + i), xi)));
+				vi = _mm256_add_ps(vi, _mm256_mul_ps(cg, _mm256_sub_ps(gi, xi)));
+				_mm256_store_ps(v + i, vi);
+				_mm256_store_ps(x + i, _mm256_add_ps(xi, _mm256_mul_ps(step_, vi)));
+#endif
+			}
+#else
+			for (size_t i = 0; i < n; i++) {
+				auto xi = x[i];
+				auto gi = GuideRow ? g_row[i] : g;
+				auto vi = omega * v[i] + phi_p * r_p[i] * (p[i] - xi) + phi_g * r_g[i] * (gi - xi);
+				v[i] = vi;
+				x[i] = xi + step * vi;
+			}
+#endif
+		}
+
+	private:
+		size_t _size;
+		size_t _dimensions;
+		size_t _stride;
+		std::vector<float> _storage;
+		float *_base;
+		std::vector<float> _fitness;
+		std::vector<float> _optima_fitness;
+		std::vector<float> _global;
+		float _global_fitness = INFINITY;
+	};
+
+	// A szemelyes optimumok kozzetett masolata az aszinkron frissiteshez.
+	//
+	// Egy reszecske optimumat mindig csak az a szal irja (publish), amelyik
+	// a reszecsket frissiti, de barmelyik szal olvashatja (read), akar
+	// iras kozben is: reszecskenkent egy verzioszamlalo jelzi, hogy az
+	// olvasott masolat konzisztens-e (seqlock), es ha nem, az olvaso ujra
+	// probalkozik. A fitness kulon, a masolat nelkul is olvashato.
+	class published_bests {
+	public:
+		published_bests(size_t n_particles, size_t dimensions)
+			: _dimensions(dimensions), _version(n_particles), _fitness(n_particles), _position(n_particles * dimensions) {
+			for (auto &f : _fitness) {
+				f.store(INFINITY, std::memory_order_relaxed);
+			}
+		}
+
+		float fitness(size_t i) const {
+			return _fitness[i].load(std::memory_order_relaxed);
+		}
+
+		// Az i. reszecske szemelyes optimumanak kozzetetele a rajbol
+		void publish(size_t i, soa_swarm const &swarm) {
+			auto version = _version[i].load(std::memory_order_relaxed);
+			_version[i].store(version + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			auto out = &_position[i * _dimensions];
+			for (size_t d = 0; d < _dimensions; d++) {
+				out[d].store(swarm.optima(d)[i], std::memory_order_relaxed);
+			}
+			_fitness[i].store(swarm.optima_fitness(i), std::memory_order_relaxed);
+
+			_version[i].store(version + 2, std::memory_order_release);
+		}
+
+		// Az i. reszecske kozzetett optimuma `out`-ba; a visszateresi ertek
+		// a hozza tartozo fitness
+		float read(size_t i, float *out) const {
+			auto in = &_position[i * _dimensions];
+			while (true) {
+				auto version = _version[i].load(std::memory_order_acquire);
+				if (version & 1) {
+					continue;
+				}
+				for (size_t d = 0; d < _dimensions; d++) {
+					out[d] = in[d].load(std::memory_order_relaxed);
+				}
+				auto fitness = _fitness[i].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (_version[i].load(std::memory_order_relaxed) == version) {
+					return fitness;
+				}
+			}
+		}
+
+	private:
+		size_t _dimensions;
+		std::vector<std::atomic<uint32_t>> _version;
+		std::vector<std::atomic<float>> _fitness;
+		std::vector<std::atomic<float>> _position;
+	};
+}
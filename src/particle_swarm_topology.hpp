@@ -0,0 +1,103 @@
+#pragma once
+
+// A PSO reszecskeinek szomszedsagi topologiai.
+//
+// A globalis topologiaban minden reszecske a teljes raj legjobbjat
+// koveti; a lokalis topologiakban csak a szomszedai (es sajat maga)
+// szemelyes optimumai kozul a legjobbat. A lokalis topologiakban a jo
+// megoldas hire lassabban terjed a rajban, ezert az tobb lokalis
+// optimumot jar be, mielott osszehuzodna.
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace pso {
+	enum class topology {
+		// Mindenki a teljes raj legjobbjat koveti
+		global,
+		// A reszecskek gyurube rendezve, mindket oldalon k szomszeddal
+		// (alapertelmezes: 1)
+		ring,
+		// Negy szomszed: az index szerinti elozo es kovetkezo, valamint a
+		// ~sqrt(n) oszlopos racsban a felette es alatta levo (mindketto
+		// korbeerve)
+		von_neumann,
+		// k veletlenszeruen valasztott szomszed (alapertelmezes: 3), a
+		// futas elejen rogzitve
+		random,
+	};
+
+	// Reszecskenkent a szomszedok indexei (a reszecske maga is koztuk
+	// van), egyetlen tombben, reszecskenkenti kezdoindexekkel
+	class neighborhood {
+	public:
+		neighborhood() = default;
+
+		// `k`: a ring es a random topologia parametere (0 = alapertelmezes);
+		// a globalis topologiahoz nincs szomszedsagi lista
+		neighborhood(pso::topology topology, size_t n, size_t k, uint64_t seed) {
+			_offsets.reserve(n + 1);
+			_offsets.push_back(0);
+
+			auto add = [&](size_t i, size_t j) {
+				auto first = _neighbors.begin() + _offsets[i];
+				if (std::find(first, _neighbors.end(), uint32_t(j)) == _neighbors.end()) {
+					_neighbors.push_back(uint32_t(j));
+				}
+			};
+
+			switch (topology) {
+			case pso::topology::global:
+				_offsets.assign(n + 1, 0);
+				return;
+			case pso::topology::ring:
+				k = k == 0 ? 1 : k;
+				for (size_t i = 0; i < n; i++) {
+					add(i, i);
+					for (size_t o = 1; o <= k && o < n; o++) {
+						add(i, (i + o) % n);
+						add(i, (i + n - o % n) % n);
+					}
+					_offsets.push_back(_neighbors.size());
+				}
+				break;
+			case pso::topology::von_neumann: {
+				size_t columns = std::max(size_t(1), size_t(std::sqrt(double(n))));
+				for (size_t i = 0; i < n; i++) {
+					add(i, i);
+					add(i, (i + 1) % n);
+					add(i, (i + n - 1) % n);
+					add(i, (i + columns) % n);
+					add(i, (i + n - columns % n) % n);
+					_offsets.push_back(_neighbors.size());
+				}
+				break;
+			}
+			case pso::topology::random: {
+				k = std::min(k == 0 ? 3 : k, n - 1);
+				std::mt19937_64 rand(seed);
+				std::uniform_int_distribution<size_t> dist(0, n - 1);
+				for (size_t i = 0; i < n; i++) {
+					add(i, i);
+					while (_neighbors.size() - _offsets[i] < k + 1) {
+						add(i, dist(rand));
+					}
+					_offsets.push_back(_neighbors.size());
+				}
+				break;
+			}
+			}
+		}
+
+		uint32_t const *begin(size_t i) const { return _neighbors.data() + _offsets[i]; }
+		uint32_t const *end(size_t i) const { return _neighbors.data() + _offsets[i + 1]; }
+
+	private:
+		std::vector<size_t> _offsets;
+		std::vector<uint32_t> _neighbors;
+	};
+}
@@ -1,11 +1,22 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
 #include <random>
+#include <unordered_map>
 #include <vector>
 #include <functional>
 #include <iterator>
 
+#include "bloat_control.hpp"
+#include "gp_profile.hpp"
+#include "maze_grid.hpp"
+#include "program_hash.hpp"
+#include "thread_pool.hpp"
+
 class path_finding_program {
 public:
     enum level_tile {
@@ -32,6 +43,8 @@ public:
     struct instruction {
         operation op;
         int param;
+
+        friend bool operator==(instruction const &, instruction const &) = default;
     };
 
     using program = std::vector<instruction>;
@@ -40,24 +53,66 @@ public:
     using solution_with_fitness = std::pair<program, float>;
     using evaluated_population = std::vector<solution_with_fitness>;
 
-    path_finding_program(level const *level) : _level(level) {
-        _exit_x = _exit_y = _start_x = _start_y = -1;
+    struct program_state {
+        int x = 0;
+        int y = 0;
+        int dx = 1;
+        int dy = 0;
+        bool flag_exit = false;
+        bool flag_bump = false;
+        int pc = 0;
+        int steps = 0;
+    };
 
-        for (int y = 0; y < _level->height; y++) {
-            for (int x = 0; x < _level->width; x++) {
-                auto t = _level->tiles[y * _level->width + x];
-                if (t == TILE_EXIT) {
-                    _exit_x = x;
-                    _exit_y = _level->height - 1 - y;
-                }
-                if (t == TILE_START) {
-                    _start_x = x;
-                    _start_y = _level->height - 1 - y;
-                }
-            }
+    // Egy futas pillanatkepe egy utasitashataron. A futas eddig csak a
+    // `prefix`-nel kisebb indexu utasitasokat hajtotta vegre, igy minden
+    // program, amelynek az elso `prefix` utasitasa ugyanez, pontosan idaig
+    // ugyanigy fut, es a futasa `state`-bol folytathato.
+    struct snapshot {
+        int prefix;
+        program_state state;
+    };
+
+    // Egy program futasainak pillanatkepei palyankent
+    using snapshot_set = std::vector<std::vector<snapshot>>;
+
+    path_finding_program(level const *L) : path_finding_program(std::vector<level const *>{ L }, 1) {
+    }
+
+    // Tobb palyas kiertekeles: a fitness a palyankenti fitness atlaga. A
+    // programokat `n_threads` szalon ertekeljuk ki (0 = ahany hardveres
+    // szal van); profilozaskor egy szalon, mert a szamlalok kozosek. Nagy
+    // palyakon a `layout` a cellak memoriabeli sorrendjet valasztja ki (lasd
+    // maze_layout).
+    path_finding_program(std::vector<level const *> const &levels, unsigned n_threads = 0, maze_layout layout = maze_layout::row_major) : _pool(GP_PROFILING ? 1 : n_threads) {
+        assert(!levels.empty());
+        for (auto L : levels) {
+            _levels.push_back(load_level_data(L, layout));
         }
 
-        assert(_exit_x > 0 && _exit_y > 0 && _start_x > 0 && _start_y > 0);
+        _bloat.max_length = 4 * program_max_length;
+        _bloat.size_fair = true;
+        _bloat.lexicographic_parsimony = true;
+    }
+
+    size_t level_count() const {
+        return _levels.size();
+    }
+
+    // Be- vagy kikapcsolja a korai leallitast: ha egy program reszleges
+    // (az eddig lefuttatott palyakon mert) atlaga mar rosszabb, mint az
+    // elozo kiertekeles elitjenek leggyengebbje, a tobbi palyat nem
+    // futtatjuk le, es a fitnessze a legrosszabb (worst_fitness) lesz.
+    void set_elite_cutoff(bool enabled) {
+        _use_cutoff = enabled;
+    }
+
+    void set_bloat_control(genetic::bloat_control const &bc) {
+        _bloat = bc;
+    }
+
+    genetic::bloat_control const &bloat_control() const {
+        return _bloat;
     }
 
     population init_population() {
@@ -71,26 +126,181 @@ public:
     }
 
     evaluated_population evaluate(population const &pop) {
+        GP_PROFILE_EVALUATION(_profile);
         evaluated_population ret;
 
+        auto avg_length = average_length(pop);
+
+        // Tarpeian: egyes tul hosszu programokat le sem futtatunk; a
+        // tobbit a forditott VM futtatja, a szalkeszleten szetosztva
+        auto &to_run = _run_index;
+        to_run.clear();
+        ret.reserve(pop.size());
         for (auto &solution : pop) {
-            ret.emplace_back(std::make_pair(solution, fitness(solution)));
+            if (genetic::tarpeian_hit(solution.size(), avg_length, _bloat, _rand)) {
+                ret.emplace_back(std::make_pair(solution, worst_fitness()));
+            } else {
+                to_run.push_back(ret.size());
+                ret.emplace_back(std::make_pair(solution, 0.0f));
+            }
         }
 
-        std::sort(ret.begin(), ret.end(), [](auto &lhs, auto &rhs) { return lhs.second < rhs.second; });
+        // A keresztezesbol szarmazo programok az orokolt pillanatkepektol
+        // folytatjak a futast (lasd crossover); a hash egyezese mellett az
+        // elotagnak is egyeznie kell a szuloevel
+        auto &hashes = _run_hash;
+        auto &inherited = _run_inherited;
+        hashes.clear();
+        inherited.clear();
+        for (auto i : to_run) {
+            auto h = hash(ret[i].first);
+            auto it = _inherited.find(h.first);
+            hashes.push_back(h);
+            auto found = it != _inherited.end() && it->second.check == h.second;
+            if (found && !same_prefix(ret[i].first, _recorded_programs[it->second.parent], size_t(it->second.prefix))) {
+                found = false;
+            }
+            inherited.push_back(found ? &it->second : nullptr);
+        }
+        _recording.resize(to_run.size());
+
+        auto cutoff = _use_cutoff ? _cutoff : INFINITY;
+        _pool.parallel_for(to_run.size(), evaluation_grain, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                auto &sf = ret[to_run[i]];
+                auto I = inherited[i];
+                if (I != nullptr) {
+                    sf.second = fitness(sf.first, cutoff, &_recorded[I->parent], I->prefix, _recording[i]);
+                } else {
+                    sf.second = fitness(sf.first, cutoff, nullptr, 0, _recording[i]);
+                }
+            }
+        });
+
+        // A most futtatott programok pillanatkepei a kovetkezo keresztezesekhez
+        std::swap(_recorded, _recording);
+        _inherited.clear();
+        _snapshots.clear();
+        _recorded_programs.resize(to_run.size());
+        for (size_t i = 0; i < to_run.size(); i++) {
+            _snapshots[hashes[i].first] = { hashes[i].second, i };
+            _recorded_programs[i] = ret[to_run[i]].first;
+        }
+
+        std::sort(ret.begin(), ret.end(), [&](auto &lhs, auto &rhs) {
+            return genetic::fitter(lhs.second, lhs.first.size(), rhs.second, rhs.first.size(), _bloat);
+        });
+
+        auto n_elite = elite_count(ret.size());
+        _cutoff = n_elite > 0 ? ret[n_elite - 1].second : INFINITY;
 
         return ret;
     }
 
+    static size_t elite_count(size_t n_solutions) {
+        return n_solutions / 8;
+    }
+
+    // A legrosszabb fitness (palyankent a kijarattol nem elerheto cellak
+    // tavolsaga, atlagolva)
+    float worst_fitness() const {
+        float sum = 0;
+        for (auto &L : _levels) {
+            sum += float(L.unreachable_distance);
+        }
+        return sum / _levels.size();
+    }
+
+    // A kezdopontbol a kijaratig vezeto legrovidebb ut hossza
+    int optimal_path_length(size_t level_index = 0) const {
+        auto &L = _levels[level_index];
+        return L.distance[L.grid.index(L.start_x, L.start_y)];
+    }
+
+    // A populacio legjobb programjanak a kijarattol mert (atlagos)
+    // tavolsaga a legrovidebb ut (atlagos) hosszahoz kepest (0 = minden
+    // palyan eljut a kijaratig). Nem also korlathoz mert res, mint a
+    // TSP-nel: a hatralevo ut aranya (lasd reports_optimality_gap).
+    float optimality_gap(evaluated_population const &pop) const {
+        float optimal = 0;
+        for (size_t i = 0; i < _levels.size(); i++) {
+            optimal += float(optimal_path_length(i));
+        }
+        optimal /= _levels.size();
+        if (pop.empty() || optimal <= 0) {
+            return NAN;
+        }
+        return pop[0].second / optimal;
+    }
+
+    static float average_length(population const &pop) {
+        size_t sum = 0;
+        for (auto &solution : pop) {
+            sum += solution.size();
+        }
+        return pop.empty() ? 0 : float(sum) / pop.size();
+    }
+
     float fitness(program const &program) {
-        // exec program
-        auto callback = [](int x, int y) {};
-        auto result = execute_program(program, callback);
-        auto dx = _exit_x - result.x;
-        auto dy = _exit_y - result.y;
-        float dist = sqrtf(dx * dx + dy * dy);
+        return fitness(program, INFINITY);
+    }
 
-        return dist;
+    // A palyankenti fitness atlaga; ha a reszleges atlag (az eddigi osszeg
+    // osztva a palyak szamaval, ami also becsles) mar nagyobb a `cutoff`-nal,
+    // a tobbi palyat kihagyjuk, es az eredmeny a worst_fitness(). Az also
+    // becsles nem lehet az eredmeny: a program jobbnak latszana, mint
+    // amilyen, es a `cutoff` egy masik populacio (pl. a parosodo halmaz)
+    // kuszobe is lehet, igy a leallitott program bekerulhetne az elitbe.
+    float fitness(program const &program, float cutoff) {
+        auto n_levels = _levels.size();
+        float sum = 0;
+        for (size_t i = 0; i < n_levels; i++) {
+            sum += fitness(execute_translated(program, i), i);
+            if (i + 1 < n_levels && sum / n_levels > cutoff) {
+                return worst_fitness();
+            }
+        }
+        return sum / n_levels;
+    }
+
+    // Mint a fitness(program, cutoff), de palyankent a `parent` legfeljebb
+    // `prefix` hosszu elotagtol fuggo pillanatkepeitol folytatja a futast
+    // (ha nem nullptr; a program elso `prefix` utasitasa ugyanaz, mint a
+    // szuloe), a program sajat pillanatkepeit pedig a `recorded`-be gyujti
+    float fitness(program const &program, float cutoff, snapshot_set const *parent, int prefix, snapshot_set &recorded) {
+        auto n_levels = _levels.size();
+        recorded.resize(n_levels);
+        for (auto &snapshots : recorded) {
+            snapshots.clear();
+        }
+
+        float sum = 0;
+        for (size_t i = 0; i < n_levels; i++) {
+            if (parent != nullptr) {
+                for (auto &S : (*parent)[i]) {
+                    if (S.prefix > prefix) {
+                        break;
+                    }
+                    recorded[i].push_back(S);
+                }
+            }
+            sum += fitness(execute_snapshotted(program, recorded[i], i), i);
+            if (i + 1 < n_levels && sum / n_levels > cutoff) {
+                return worst_fitness();
+            }
+        }
+        return sum / n_levels;
+    }
+
+    // A vegallapot tavolsaga a kijarattol a palyan (falakat megkerulve),
+    // az elore kiszamolt tavolsagmezobol
+    float fitness(program_state const &result, size_t level_index = 0) {
+        auto &L = _levels[level_index];
+        if (result.x < 0 || result.x >= L.source->width || result.y < 0 || result.y >= L.source->height) {
+            return float(L.unreachable_distance);
+        }
+        auto dist = L.distance[L.grid.index(result.x, result.y)];
+        return float(dist < 0 ? L.unreachable_distance : dist);
     }
 
     float average_fitness(evaluated_population const &pop) {
@@ -153,7 +363,9 @@ public:
                     contender = generate_random_index();
                 }
 
-                if (pop[subject_idx].second < pop[contender].second) {
+                auto &subject = pop[subject_idx];
+                auto &other = pop[contender];
+                if (genetic::fitter(subject.second, subject.first.size(), other.second, other.first.size(), _bloat)) {
                     duels_won++;
                 }
                 duels_played++;
@@ -179,22 +391,65 @@ public:
         auto &p0 = parents[0];
         auto &p1 = parents[1];
 
-        auto dist_p0_idx = std::uniform_int_distribution(size_t(0), p0.size() - 1);
-        auto dist_p1_idx = std::uniform_int_distribution(size_t(0), p1.size() - 1);
+        auto [idx_p0, idx_p1] = genetic::crossover_points(p0.size(), p1.size(), _bloat, _rand);
 
-        auto idx_p0 = dist_p0_idx(_rand);
-        auto idx_p1 = dist_p1_idx(_rand);
+        if (genetic::exceeds_max_length(idx_p0 + (p1.size() - idx_p1), _bloat)) {
+            inherit_snapshots(p0, p0.size(), p0);
+            return p0;
+        }
 
         ret.insert(ret.end(), p0.begin(), p0.begin() + idx_p0);
         ret.insert(ret.end(), p1.begin() + idx_p1, p1.end());
 
+        // Az utod az elso idx_p0 utasitasig ugyanugy fut, mint p0
+        inherit_snapshots(p0, idx_p0, ret);
+
         return ret;
     }
 
+    // A `child` megkapja a `parent` utolso kiertekelesebol azokat a
+    // pillanatkepeket, amelyek csak az elso `prefix` utasitastol fuggnek
+    // (a ket program ezekben megegyezik); a kovetkezo evaluate ezektol
+    // folytatja a futasat
+    void inherit_snapshots(program const &parent, size_t prefix, program const &child) {
+        auto parent_hash = hash(parent);
+        auto it = _snapshots.find(parent_hash.first);
+        if (it == _snapshots.end() || it->second.first != parent_hash.second) {
+            return;
+        }
+        if (!same_prefix(parent, _recorded_programs[it->second.second], prefix)) {
+            return;
+        }
+
+        // Van-e egyaltalan hasznalhato pillanatkep
+        auto &recorded = _recorded[it->second.second];
+        auto usable = std::any_of(recorded.begin(), recorded.end(), [&](auto &snapshots) {
+            return !snapshots.empty() && snapshots.front().prefix <= int(prefix);
+        });
+
+        if (usable) {
+            auto child_hash = hash(child);
+            _inherited[child_hash.first] = { child_hash.second, it->second.second, int(prefix) };
+        }
+    }
+
+    // Az elso `prefix` utasitasa megegyezik-e a ket programnak
+    static bool same_prefix(program const &lhs, program const &rhs, size_t prefix) {
+        return lhs.size() >= prefix && rhs.size() >= prefix && std::equal(lhs.begin(), lhs.begin() + prefix, rhs.begin());
+    }
+
+    // Ket fuggetlen 64 bites hash a program tartalmarol
+    static std::pair<uint64_t, uint64_t> hash(program const &P) {
+        return genetic::program_hash(P, [](instruction const &I, auto const &mix) {
+            mix(uint64_t(I.op));
+            mix(uint64_t(uint32_t(I.param)));
+        });
+    }
+
     solution find_best_in(population const &pop) {
         auto pop_fit = evaluate(pop);
         auto best = pop_fit[0];
-        printf("top fitness: %f | avg fitness: %f\n", best.second, average_fitness(pop_fit));
+        printf("top fitness: %f | avg fitness: %f | avg length: %.1f\n", best.second, average_fitness(pop_fit), average_length(pop));
         return best.first;
     }
 
@@ -223,23 +478,12 @@ public:
         return ret;
     }
 
-    struct program_state {
-        int x = 0;
-        int y = 0;
-        int dx = 1;
-        int dy = 0;
-        bool flag_exit = false;
-        bool flag_bump = false;
-        int pc = 0;
-        int steps = 0;
-    };
-
     template<typename Callback>
-    program_state execute_program(program const &P, Callback const& callback) {
+    program_state execute_program(program const &P, Callback const& callback, size_t level_index = 0) {
         program_state state;
 
-        state.x = _start_x;
-        state.y = _start_y;
+        state.x = _levels[level_index].start_x;
+        state.y = _levels[level_index].start_y;
 
         /*
         printf("====================\n");
@@ -253,51 +497,37 @@ public:
         printf("====================\n");
         */
 
-        while (state.steps < 1000 && state.pc >= 0 && state.pc < P.size()) {
-            // Fetch
-            auto &instr = P[state.pc];
-            state.steps++;
-
-            // Execute
-            auto next_pc = state.pc + 1;
-            switch (instr.op) {
-            case OP_RELJMP:
-                next_pc = state.pc + instr.param;
-                break;
-            case OP_MOVFWD:
-                if (!state.flag_bump) {
-                    state.x += state.dx;
-                    state.y += state.dy;
-                }
-                break;
-            case OP_LTURN:
-                rotate_left(state);
-                break;
-            case OP_RTURN:
-                rotate_right(state);
-                break;
-            case OP_SKIPWALL:
-                if (state.flag_bump) {
-                    next_pc = state.pc + 2;
-                }
-                break;
-            }
+        resume_program(P, state, callback, level_index);
+        GP_PROFILE_PROGRAM(_profile, state.steps, hit_step_limit(P, state));
+        return state;
+    }
 
-            if (sample_level(state.x, state.y) == TILE_EXIT) {
-                state.flag_exit = true;
-            }
+    // A lepesszam-korlat miatt allt-e le a futas?
+    static bool hit_step_limit(program const &P, program_state const &state) {
+        return state.steps >= 1000 && !state.flag_exit && state.pc >= 0 && state.pc < int(P.size());
+    }
 
-            if (sample_level(state.x + state.dx, state.y + state.dy) == TILE_WALL) {
-                state.flag_bump = true;
-            } else {
-                state.flag_bump = false;
-            }
+#if GP_PROFILING
+    using profile_stats = gp_profile::counters;
 
-            callback(state.x, state.y);
+    // Az utolso hivas ota gyujtott profil
+    profile_stats take_profile() {
+        auto ret = _profile;
+        _profile = {};
+        return ret;
+    }
 
-            state.pc = next_pc;
+    static void print_profile(FILE *f, profile_stats const &stats) {
+        static char const *const names[] = { "reljmp", "movfwd", "lturn", "rturn", "skipwall" };
+        stats.print(f, names, OP_MAX);
+    }
+#endif
 
-            if (state.flag_exit) {
+    // Folytatja a program futtatasat a `state` allapotbol
+    template<typename Callback>
+    void resume_program(program const &P, program_state &state, Callback const &callback, size_t level_index = 0) {
+        while (state.steps < 1000 && state.pc >= 0 && state.pc < P.size()) {
+            if (step_program(P, state, callback, level_index)) {
                 break;
             }
         }
@@ -309,10 +539,499 @@ public:
             state.x = -10000;
             state.y = -10000;
         }
+    }
+
+    // Vegrehajtja a `state.pc` helyen levo utasitast; igazzal ter vissza, ha
+    // a program elerte a kijaratot
+    template<typename Callback>
+    bool step_program(program const &P, program_state &state, Callback const &callback, size_t level_index = 0) {
+        // Fetch
+        auto &instr = P[state.pc];
+        state.steps++;
+        GP_PROFILE_OP(_profile, instr.op);
+
+        // Execute
+        auto next_pc = state.pc + 1;
+        switch (instr.op) {
+        case OP_RELJMP:
+            next_pc = state.pc + instr.param;
+            break;
+        case OP_MOVFWD:
+            if (!state.flag_bump) {
+                state.x += state.dx;
+                state.y += state.dy;
+            }
+            break;
+        case OP_LTURN:
+            rotate_left(state);
+            break;
+        case OP_RTURN:
+            rotate_right(state);
+            break;
+        case OP_SKIPWALL:
+            if (state.flag_bump) {
+                next_pc = state.pc + 2;
+            }
+            break;
+        }
+
+        auto &grid = _levels[level_index].grid;
+        auto cell = grid[grid.index(state.x, state.y)];
+        if (maze_grid::is_exit(cell)) {
+            state.flag_exit = true;
+        }
+        state.flag_bump = maze_grid::wall_ahead(cell, maze_grid::direction(state.dx, state.dy));
+
+        callback(state.x, state.y);
+
+        state.pc = next_pc;
+
+        return state.flag_exit;
+    }
+
+    // A forditott VM utasitaskeszlete: az eredeti muveletek, a gyakori
+    // sorozatokbol osszevont "szuperutasitasok" es a program vegen allo
+    // HALT
+    enum vm_operation : uint8_t {
+        VM_RELJMP,
+        VM_MOVFWD,
+        VM_LTURN,
+        VM_RTURN,
+        VM_SKIPWALL,
+        // lturn; movfwd
+        VM_LTURN_MOVFWD,
+        // rturn; movfwd
+        VM_RTURN_MOVFWD,
+        // movfwd; movfwd
+        VM_MOVFWD_MOVFWD,
+        // skipwall; reljmp
+        VM_SKIPWALL_RELJMP,
+        // movfwd; skipwall; reljmp
+        VM_MOVFWD_SKIPWALL_RELJMP,
+        VM_HALT,
+        VM_MAX
+    };
 
+    // Egy forditott utasitas. A forditott program indexei megegyeznek az
+    // eredetiekkel (a szuperutasitas az elso tagja helyen all, a tobbi
+    // tag helyen a sajat, nem osszevont valtozatuk marad, igy a sorozat
+    // kozepere ugras is helyes), a vegen ket HALT all. Az ugrasok celja
+    // elore kiszamolt: `target` az uj pc, `slot` a celutasitas indexe (a
+    // programon kivulre mutato ugrasoknal az elso HALT-e). `span` az
+    // utasitas altal lefedett eredeti utasitasok szama.
+    struct vm_instruction {
+        vm_operation op;
+        uint8_t span;
+        int target;
+        int slot;
+    };
+
+    // A forditott program szalankenti munkaterulete (az evaluate tobb szalon
+    // futtatja a VM-et)
+    static std::vector<vm_instruction> &scratch_code() {
+        static thread_local std::vector<vm_instruction> code;
+        return code;
+    }
+
+    // Leforditja a programot a VM szamara
+    void translate(program const &P, std::vector<vm_instruction> &out) {
+        auto N = int(P.size());
+        out.resize(N + 2);
+
+        auto op_at = [&](int i) {
+            return i < N ? P[i].op : OP_MAX;
+        };
+
+        for (int i = 0; i < N; i++) {
+            auto &I = out[i];
+            I.op = vm_operation(P[i].op);
+            I.span = 1;
+            I.target = 0;
+            I.slot = 0;
+
+            // Az (esetleg osszevont) sorozat utolso ugrasanak celja
+            auto jump_at = [&](int j) {
+                I.target = j + P[j].param;
+                I.slot = (I.target >= 0 && I.target < N) ? I.target : N;
+            };
+
+            auto op0 = op_at(i);
+            auto op1 = op_at(i + 1);
+            auto op2 = op_at(i + 2);
+            if (op0 == OP_MOVFWD && op1 == OP_SKIPWALL && op2 == OP_RELJMP) {
+                I.op = VM_MOVFWD_SKIPWALL_RELJMP;
+                I.span = 3;
+                jump_at(i + 2);
+            } else if (op0 == OP_SKIPWALL && op1 == OP_RELJMP) {
+                I.op = VM_SKIPWALL_RELJMP;
+                I.span = 2;
+                jump_at(i + 1);
+            } else if (op0 == OP_LTURN && op1 == OP_MOVFWD) {
+                I.op = VM_LTURN_MOVFWD;
+                I.span = 2;
+            } else if (op0 == OP_RTURN && op1 == OP_MOVFWD) {
+                I.op = VM_RTURN_MOVFWD;
+                I.span = 2;
+            } else if (op0 == OP_MOVFWD && op1 == OP_MOVFWD) {
+                I.op = VM_MOVFWD_MOVFWD;
+                I.span = 2;
+            } else if (op0 == OP_RELJMP) {
+                jump_at(i);
+            }
+        }
+
+        out[N] = { VM_HALT, 1, N, N };
+        out[N + 1] = { VM_HALT, 1, N + 1, N + 1 };
+    }
+
+    // Futtatja a programot a forditott VM-mel. Az eredmeny ugyanaz, mint az
+    // execute_program-e (callback nelkul).
+    program_state execute_translated(program const &P, size_t level_index = 0) {
+        program_state state;
+        state.x = _levels[level_index].start_x;
+        state.y = _levels[level_index].start_y;
+
+        auto &code = scratch_code();
+        translate(P, code);
+        resume_translated(P, code, state, level_index);
+        GP_PROFILE_PROGRAM(_profile, state.steps, hit_step_limit(P, state));
+        return state;
+    }
+
+    // Mint az execute_translated, de ha a `snapshots` nem ures (egy olyan
+    // program pillanatkepei ezen a palyan, amelynek az elejet P orokolte),
+    // az utolso pillanatkeprol folytatja a futast. A futas kozben az uj
+    // pillanatkepeket a `snapshots`-hoz fuzi.
+    program_state execute_snapshotted(program const &P, std::vector<snapshot> &snapshots, size_t level_index = 0) {
+        program_state state;
+        if (snapshots.empty()) {
+            state.x = _levels[level_index].start_x;
+            state.y = _levels[level_index].start_y;
+        } else {
+            state = snapshots.back().state;
+            GP_PROFILE_RESUMED(_profile, state.steps);
+        }
+
+        auto &code = scratch_code();
+        translate(P, code);
+        resume_translated(P, code, state, level_index, &snapshots);
+        GP_PROFILE_PROGRAM(_profile, state.steps, hit_step_limit(P, state));
         return state;
     }
 
+    // Folytatja a futtatast a forditott programmal.
+    //
+    // A VM kihasznalja, hogy az elso lepes utan a bump flag mindig a
+    // jelenlegi allapothoz tartozik, es hogy a poziciot (igy a kijaratot)
+    // csak a movfwd valtoztatja: a bump flaget csak mozgas es fordulas
+    // utan, a kijaratot csak mozgas utan kell ujraszamolni. Az elso
+    // lepest (amikor a bump meg a kezdeti hamis ertek) a sima interpreter
+    // hajtja vegre.
+    //
+    // Vegtelen ciklus felismerese: az elso lepes utan a VM teljes allapota
+    // (pc, pozicio, irany; a bump ezekbol kovetkezik) veges, es ciklus csak
+    // hatrafele ugrason at johet letre. A hatrafele ugrasok utani
+    // allapotokon Brent algoritmusa fut; ha egy allapot ismetlodik, a
+    // futas onnantol periodikus, igy a lepesszam-korlatig hatralevo teljes
+    // periodusokat atugorjuk. A maradek (egy periodusnal kevesebb) lepest
+    // vegrehajtjuk, tehat a vegallapot pontosan ugyanaz, mintha mind az
+    // 1000 lepest lefuttattuk volna.
+    //
+    // Ha `snapshots` nem nullptr, a futas pillanatkepeket fuz hozza (lasd
+    // snapshot); eddigi elemei a `state`-hez vezeto futas pillanatkepei (ha
+    // ures, a futas a kezdoallapotbol indul).
+    void resume_translated(program const &P, std::vector<vm_instruction> const &code, program_state &state, size_t level_index = 0, std::vector<snapshot> *snapshots = nullptr) {
+        auto N = int(P.size());
+        if (state.steps == 0 && N > 0) {
+            auto callback = [](int x, int y) {};
+            step_program(P, state, callback, level_index);
+            if (state.flag_exit) {
+                return;
+            }
+        }
+        if (state.pc < 0 || state.pc >= N) {
+            return;
+        }
+
+        // A palya elrendezese szerint peldanyositott VM
+        auto &grid = _levels[level_index].grid;
+        auto row_major = grid.layout() == maze_layout::row_major;
+        if (snapshots == nullptr) {
+            if (row_major) {
+                run_translated<row_major_cursor, false>(P, code, state, grid, nullptr);
+            } else {
+                run_translated<table_cursor, false>(P, code, state, grid, nullptr);
+            }
+        } else {
+            if (row_major) {
+                run_translated<row_major_cursor, true>(P, code, state, grid, snapshots);
+            } else {
+                run_translated<table_cursor, true>(P, code, state, grid, snapshots);
+            }
+        }
+    }
+
+    template<typename Cursor, bool Record>
+    void run_translated(program const &P, std::vector<vm_instruction> const &code, program_state &state, maze_grid const &grid, std::vector<snapshot> *snapshots) {
+        auto N = int(P.size());
+
+        // Az allapot: pozicio, iranyindex es a jelenlegi cella bajtja (a
+        // fordulashoz nem kell a palyat olvasni)
+        auto cells = grid.data();
+        Cursor cursor(grid, state.x, state.y);
+        int dir = maze_grid::direction(state.dx, state.dy);
+        uint8_t here = cells[cursor.pos()];
+        int steps = state.steps;
+        int ip = state.pc;
+        int pc = ip;
+        bool bump = state.flag_bump;
+        bool exit = false;
+
+        // Brent algoritmusa: a mentett allapot, a mentes ota eltelt
+        // hatrafele ugrasok szama es a kovetkezo mentesig hatralevo hatar
+        uint64_t cycle_key = UINT64_MAX;
+        int cycle_steps = 0;
+        int cycle_length = 0;
+        int cycle_power = 1;
+        auto detect_cycle = [&]() {
+            auto key = (uint64_t(uint32_t(cursor.pos())) << 32) | (uint64_t(ip) << 2) | uint64_t(dir);
+            if (key == cycle_key) {
+                auto period = steps - cycle_steps;
+                auto skipped = (1000 - steps) / period * period;
+                steps += skipped;
+                GP_PROFILE_SKIPPED(_profile, skipped);
+                // A korlatig mar egy periodus sincs hatra
+                cycle_key = UINT64_MAX;
+                cycle_power = INT_MAX;
+                return;
+            }
+            if (++cycle_length == cycle_power) {
+                cycle_key = key;
+                cycle_steps = steps;
+                cycle_length = 0;
+                cycle_power *= 2;
+            }
+        };
+
+        // Pillanatkepek: `frontier` az eddig vegrehajtott (vagy egy
+        // osszevont utasitasban vegrehajthato) legnagyobb indexu utasitas
+        // utani index. Ha a VM ennel nem kisebb indexu utasitashoz er, a
+        // futas eddig csak az elso `frontier` utasitastol fuggott; ilyenkor
+        // (ha az elozo ota legalabb snapshot_interval lepes telt el) mentjuk
+        // az allapotot.
+        int frontier = 1;
+        int last_snapshot = steps;
+        if (Record && !snapshots->empty()) {
+            frontier = snapshots->back().prefix;
+        }
+        auto record = [&]() {
+            if (ip >= frontier && steps - last_snapshot >= snapshot_interval) {
+                snapshot S;
+                S.prefix = frontier;
+                S.state.x = cursor.x();
+                S.state.y = cursor.y();
+                S.state.dx = maze_grid::direction_dx(dir);
+                S.state.dy = maze_grid::direction_dy(dir);
+                S.state.flag_bump = bump;
+                S.state.pc = ip;
+                S.state.steps = steps;
+                snapshots->push_back(S);
+                last_snapshot = steps;
+            }
+            frontier = ip + code[ip].span;
+        };
+        if (Record) {
+            frontier = std::max(frontier, ip + code[ip].span);
+        }
+
+        // movfwd; igazzal ter vissza, ha a kijaratra lepett
+        auto move = [&]() {
+            if (!bump) {
+                cursor.step(dir);
+                here = cells[cursor.pos()];
+                exit = maze_grid::is_exit(here);
+                bump = maze_grid::wall_ahead(here, dir);
+            }
+            return exit;
+        };
+        auto turn_left = [&]() {
+            dir = (dir + 1) & 3;
+            bump = maze_grid::wall_ahead(here, dir);
+        };
+        auto turn_right = [&]() {
+            dir = (dir + 3) & 3;
+            bump = maze_grid::wall_ahead(here, dir);
+        };
+
+#if defined(__GNUC__)
+        // "labels as values": minden utasitas vegen kozvetlen ugras a
+        // kovetkezo kezelojere
+        static void *const dispatch_table[VM_MAX] = {
+            &&vm_reljmp, &&vm_movfwd, &&vm_lturn, &&vm_rturn, &&vm_skipwall,
+            &&vm_lturn_movfwd, &&vm_rturn_movfwd, &&vm_movfwd_movfwd,
+            &&vm_skipwall_reljmp, &&vm_movfwd_skipwall_reljmp, &&vm_halt,
+        };
+#define VM_DISPATCH() goto *dispatch_table[code[ip].op]
+#define VM_CASE(name) name
+#else
+#define VM_DISPATCH() goto dispatch
+#define VM_CASE(name) case_##name
+#endif
+        // A lepesszam-korlat ellenorzese `n` lepes elott; ha nem fer bele,
+        // az osszevont utasitas helyett az elso tagjat hajtjuk vegre
+#define VM_BUDGET(n, fallback) if (steps + (n) > 1000) goto VM_CASE(fallback); steps += (n)
+        // A kovetkezo utasitas (pillanatkep-mentessel, ha kell)
+#define VM_NEXT() if (Record && ip + code[ip].span > frontier) { record(); } VM_DISPATCH()
+#define VM_STEP() if (steps >= 1000) { pc = ip; goto done; } steps++
+#define VM_JUMP(I) if ((I).slot == N) { pc = (I).target; goto done; } \
+        if ((I).slot <= ip) { ip = (I).slot; detect_cycle(); } else { ip = (I).slot; }
+
+#if !defined(__GNUC__)
+    dispatch:
+        switch (code[ip].op) {
+        case VM_RELJMP: goto case_vm_reljmp;
+        case VM_MOVFWD: goto case_vm_movfwd;
+        case VM_LTURN: goto case_vm_lturn;
+        case VM_RTURN: goto case_vm_rturn;
+        case VM_SKIPWALL: goto case_vm_skipwall;
+        case VM_LTURN_MOVFWD: goto case_vm_lturn_movfwd;
+        case VM_RTURN_MOVFWD: goto case_vm_rturn_movfwd;
+        case VM_MOVFWD_MOVFWD: goto case_vm_movfwd_movfwd;
+        case VM_SKIPWALL_RELJMP: goto case_vm_skipwall_reljmp;
+        case VM_MOVFWD_SKIPWALL_RELJMP: goto case_vm_movfwd_skipwall_reljmp;
+        default: goto case_vm_halt;
+        }
+#else
+        VM_DISPATCH();
+#endif
+
+    VM_CASE(vm_reljmp):
+        VM_STEP();
+        GP_PROFILE_OP(_profile, OP_RELJMP);
+        VM_JUMP(code[ip]);
+        VM_NEXT();
+
+    VM_CASE(vm_movfwd):
+        VM_STEP();
+        GP_PROFILE_OP(_profile, OP_MOVFWD);
+        ip++;
+        if (move()) {
+            pc = ip;
+            goto done;
+        }
+        VM_NEXT();
+
+    VM_CASE(vm_lturn):
+        VM_STEP();
+        GP_PROFILE_OP(_profile, OP_LTURN);
+        turn_left();
+        ip++;
+        VM_NEXT();
+
+    VM_CASE(vm_rturn):
+        VM_STEP();
+        GP_PROFILE_OP(_profile, OP_RTURN);
+        turn_right();
+        ip++;
+        VM_NEXT();
+
+    VM_CASE(vm_skipwall):
+        VM_STEP();
+        GP_PROFILE_OP(_profile, OP_SKIPWALL);
+        ip += bump ? 2 : 1;
+        VM_NEXT();
+
+    VM_CASE(vm_lturn_movfwd):
+        VM_BUDGET(2, vm_lturn);
+        GP_PROFILE_OP(_profile, OP_LTURN);
+        GP_PROFILE_OP(_profile, OP_MOVFWD);
+        turn_left();
+        ip += 2;
+        if (move()) {
+            pc = ip;
+            goto done;
+        }
+        VM_NEXT();
+
+    VM_CASE(vm_rturn_movfwd):
+        VM_BUDGET(2, vm_rturn);
+        GP_PROFILE_OP(_profile, OP_RTURN);
+        GP_PROFILE_OP(_profile, OP_MOVFWD);
+        turn_right();
+        ip += 2;
+        if (move()) {
+            pc = ip;
+            goto done;
+        }
+        VM_NEXT();
+
+    VM_CASE(vm_movfwd_movfwd):
+        VM_BUDGET(2, vm_movfwd);
+        GP_PROFILE_OP(_profile, OP_MOVFWD);
+        if (move()) {
+            // Mar az elso lepes a kijaratra vitt
+            steps--;
+            pc = ip + 1;
+            goto done;
+        }
+        GP_PROFILE_OP(_profile, OP_MOVFWD);
+        ip += 2;
+        if (move()) {
+            pc = ip;
+            goto done;
+        }
+        VM_NEXT();
+
+    VM_CASE(vm_skipwall_reljmp):
+        VM_BUDGET(2, vm_skipwall);
+        GP_PROFILE_OP(_profile, OP_SKIPWALL);
+        if (bump) {
+            steps--;
+            ip += 2;
+        } else {
+            GP_PROFILE_OP(_profile, OP_RELJMP);
+            VM_JUMP(code[ip]);
+        }
+        VM_NEXT();
+
+    VM_CASE(vm_movfwd_skipwall_reljmp):
+        VM_BUDGET(3, vm_movfwd);
+        GP_PROFILE_OP(_profile, OP_MOVFWD);
+        if (move()) {
+            steps -= 2;
+            pc = ip + 1;
+            goto done;
+        }
+        GP_PROFILE_OP(_profile, OP_SKIPWALL);
+        if (bump) {
+            steps--;
+            ip += 3;
+        } else {
+            GP_PROFILE_OP(_profile, OP_RELJMP);
+            VM_JUMP(code[ip]);
+        }
+        VM_NEXT();
+
+    VM_CASE(vm_halt):
+        pc = ip;
+
+    done:
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_CASE
+#undef VM_BUDGET
+#undef VM_STEP
+#undef VM_JUMP
+        state.x = cursor.x();
+        state.y = cursor.y();
+        state.dx = maze_grid::direction_dx(dir);
+        state.dy = maze_grid::direction_dy(dir);
+        state.steps = steps;
+        state.pc = pc;
+        state.flag_bump = bump;
+        state.flag_exit = exit;
+    }
+
     void rotate_left(program_state &state) {
         int dx1 = -state.dy;
         int dy1 = state.dx;
@@ -327,15 +1046,15 @@ public:
         state.dy = dy1;
     }
 
-    level_tile sample_level(int x, int y) {
-        if (x < 0 || x >= _level->width || y < 0 || y >= _level->height) {
+    static level_tile sample_level(level const &L, int x, int y) {
+        if (x < 0 || x >= L.width || y < 0 || y >= L.height) {
             return TILE_WALL;
         }
 
-        auto row = _level->height - 1 - y;
+        auto row = L.height - 1 - y;
         auto col = x;
 
-        return _level->tiles[row * _level->width + col];
+        return L.tiles[row * L.width + col];
     }
 
     void disassemble(instruction const &I, char const *&mnemonic, int &param) {
@@ -353,11 +1072,99 @@ private:
     const size_t program_min_length = 4;
     const size_t program_max_length = 20;
 
-    level const *_level;
-    int _start_x;
-    int _start_y;
-    int _exit_x;
-    int _exit_y;
+    // Egy palya es az interpreterek szamara elofeldolgozott valtozata
+    struct level_data {
+        level const *source;
+        maze_grid grid;
+        int start_x, start_y;
+        int exit_x, exit_y;
+        // A kijarattol mert legrovidebb ut hossza cellankent (cellaindex
+        // szerint, -1 = nem elerheto); a nem elerheto cellak tavolsaga a
+        // legnagyobb tavolsag + 1
+        std::vector<int> distance;
+        int unreachable_distance;
+    };
+
+    static level_data load_level_data(level const *L, maze_layout layout) {
+        level_data ret;
+        ret.source = L;
+        ret.exit_x = ret.exit_y = ret.start_x = ret.start_y = -1;
+
+        for (int y = 0; y < L->height; y++) {
+            for (int x = 0; x < L->width; x++) {
+                auto t = L->tiles[y * L->width + x];
+                if (t == TILE_EXIT) {
+                    ret.exit_x = x;
+                    ret.exit_y = L->height - 1 - y;
+                }
+                if (t == TILE_START) {
+                    ret.start_x = x;
+                    ret.start_y = L->height - 1 - y;
+                }
+            }
+        }
+
+        assert(ret.exit_x > 0 && ret.exit_y > 0 && ret.start_x > 0 && ret.start_y > 0);
+
+        ret.grid = maze_grid(L->width, L->height, [&](int x, int y) {
+            auto t = sample_level(*L, x, y);
+            return t == TILE_WALL ? maze_grid::WALL : t == TILE_EXIT ? maze_grid::EXIT : uint8_t(0);
+        }, layout);
+
+        ret.distance = ret.grid.distances_from(ret.exit_x, ret.exit_y);
+        ret.unreachable_distance = *std::max_element(ret.distance.begin(), ret.distance.end()) + 1;
+
+        return ret;
+    }
+
+    // A kiertekeles egy feladata ennyi programot futtat
+    static constexpr size_t evaluation_grain = 4;
+
+    // Ket pillanatkep kozott legalabb ennyi lepes telik el
+    static constexpr int snapshot_interval = 4;
+
+    // Egy utod oroksege (lasd inherit_snapshots): `parent` a szulo
+    // pillanatkepeinek indexe a _recorded-ben, `prefix` a kozos elotag
+    // hossza
+    struct inheritance {
+        uint64_t check;
+        size_t parent;
+        int prefix;
+    };
+
+    std::vector<level_data> _levels;
+
+    // Az evaluate munkaterulete: a futtatando programok indexei, hash-e es
+    // orokolt pillanatkepei
+    std::vector<size_t> _run_index;
+    std::vector<std::pair<uint64_t, uint64_t>> _run_hash;
+    std::vector<inheritance const *> _run_inherited;
+
+    // Az utolso evaluate-ben futtatott programok pillanatkepei es maguk a
+    // programok (a futtatasi sorrendben), es program hash -> (masodik hash,
+    // index a _recorded-ben). Az evaluate a _recording-ba gyujt (kozben a
+    // _recorded-bol olvas), majd a kettot megcsereli. A hash egyezeset a
+    // _recorded_programs-szal ellenorizzuk, mielott egy pillanatkepet
+    // masik programhoz hasznalnank.
+    std::vector<snapshot_set> _recorded;
+    std::vector<snapshot_set> _recording;
+    population _recorded_programs;
+    std::unordered_map<uint64_t, std::pair<uint64_t, size_t>> _snapshots;
+    // A keresztezesek ota meg ki nem ertekelt utodok orokosege: program
+    // hash -> orokseg
+    std::unordered_map<uint64_t, inheritance> _inherited;
+
+    // A korai leallitas kuszobe (az elozo kiertekeles elitjenek leggyengebb
+    // fitnesse)
+    float _cutoff = INFINITY;
+    bool _use_cutoff = true;
+
+    thread_pool _pool;
+
+#if GP_PROFILING
+    gp_profile::counters _profile;
+#endif
 
     std::mt19937 _rand;
+    genetic::bloat_control _bloat;
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+// Egy program utasitasainak nem birtokolt nezete (egy arenaban vagy egy
+// std::vector-ban levo folytonos tartomany).
+template<typename Instruction>
+class program_view {
+public:
+    program_view() = default;
+    program_view(Instruction const *data, size_t size) : _data(data), _size(size) {}
+    program_view(std::vector<Instruction> const &program) : _data(program.data()), _size(program.size()) {}
+
+    Instruction const *begin() const { return _data; }
+    Instruction const *end() const { return _data + _size; }
+    Instruction const *data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    Instruction const &operator[](size_t i) const { return _data[i]; }
+
+private:
+    Instruction const *_data = nullptr;
+    size_t _size = 0;
+};
+
+// Populacio-szintu program tarolo. Minden program utasitasa egyetlen
+// folytonos tombben van, a programokat (offset, hossz) parok azonositjak;
+// egy program beszurasa egy darab masolas a tomb vegere.
+//
+// Csak a vegere lehet beszurni; a nezetek a kovetkezo beszurasig ervenyesek.
+template<typename Instruction>
+class program_arena {
+public:
+    using view = program_view<Instruction>;
+
+    struct handle {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = view;
+
+        iterator() = default;
+        iterator(program_arena const *arena, size_t idx) : _arena(arena), _idx(idx) {}
+
+        view operator*() const { return (*_arena)[_idx]; }
+
+        view operator[](difference_type n) const { return (*_arena)[_idx + n]; }
+
+        iterator &operator++() { _idx++; return *this; }
+        iterator operator++(int) { auto ret = *this; _idx++; return ret; }
+        iterator &operator--() { _idx--; return *this; }
+        iterator operator--(int) { auto ret = *this; _idx--; return ret; }
+        iterator &operator+=(difference_type n) { _idx += n; return *this; }
+        iterator &operator-=(difference_type n) { _idx -= n; return *this; }
+        iterator operator+(difference_type n) const { return { _arena, _idx + n }; }
+        iterator operator-(difference_type n) const { return { _arena, _idx - n }; }
+        friend iterator operator+(difference_type n, iterator const &it) { return it + n; }
+        difference_type operator-(iterator const &other) const { return difference_type(_idx) - difference_type(other._idx); }
+        bool operator==(iterator const &other) const { return _idx == other._idx; }
+        bool operator!=(iterator const &other) const { return _idx != other._idx; }
+        bool operator<(iterator const &other) const { return _idx < other._idx; }
+        bool operator>(iterator const &other) const { return _idx > other._idx; }
+        bool operator<=(iterator const &other) const { return _idx <= other._idx; }
+        bool operator>=(iterator const &other) const { return _idx >= other._idx; }
+
+    private:
+        program_arena const *_arena = nullptr;
+        size_t _idx = 0;
+    };
+
+    void reserve(size_t n_programs, size_t n_instructions) {
+        _programs.reserve(n_programs);
+        _code.reserve(n_instructions);
+    }
+
+    size_t size() const {
+        return _programs.size();
+    }
+
+    friend size_t size(program_arena const &arena) {
+        return arena.size();
+    }
+
+    view operator[](size_t i) const {
+        auto h = _programs[i];
+        return { _code.data() + h.offset, h.length };
+    }
+
+    iterator begin() const {
+        return { this, 0 };
+    }
+
+    iterator end() const {
+        return { this, _programs.size() };
+    }
+
+    // Egy program a tomb vegere; a `pos` csak a container-szeru
+    // interfesz miatt van, mindig end()-nek kell lennie
+    iterator insert([[maybe_unused]] iterator pos, view program) {
+        assert(pos == end());
+        push_back(program);
+        return { this, _programs.size() - 1 };
+    }
+
+    void push_back(view program) {
+        assert(_code.size() + program.size() <= UINT32_MAX);
+        handle h = { uint32_t(_code.size()), uint32_t(program.size()) };
+        auto own = program.data() >= _code.data() && program.data() < _code.data() + _code.size();
+        if (own) {
+            // A sajat tombunkbol masolunk: az atmeretezes utan offset alapjan
+            auto from = size_t(program.data() - _code.data());
+            _code.resize(_code.size() + program.size());
+            std::copy(_code.begin() + from, _code.begin() + from + program.size(), _code.begin() + h.offset);
+        } else {
+            _code.insert(_code.end(), program.begin(), program.end());
+        }
+        _programs.push_back(h);
+    }
+
+    void clear() {
+        _code.clear();
+        _programs.clear();
+    }
+
+    // Az osszes tarolt utasitas szama
+    size_t instruction_count() const {
+        return _code.size();
+    }
+
+private:
+    std::vector<Instruction> _code;
+    std::vector<handle> _programs;
+};
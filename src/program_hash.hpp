@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+namespace genetic {
+    // Ket fuggetlen 64 bites hash (FNV-1a, illetve egy szorzo-forgato
+    // keveres) egy linearis GP program tartalmarol, a programokat kulcskent
+    // hasznalo gyorsitotarakhoz. A `fields(I, mix)` az I utasitas mezoit
+    // egyenkent adja at a `mix`-nek (uint64_t-kent); a program hossza is
+    // bekeveredik.
+    template<typename Program, typename Fields>
+    std::pair<uint64_t, uint64_t> program_hash(Program const &P, Fields const &fields) {
+        uint64_t h0 = 14695981039346656037ull;
+        uint64_t h1 = 0x9E3779B97F4A7C15ull;
+        auto mix = [&](uint64_t v) {
+            h0 = (h0 ^ v) * 1099511628211ull;
+            h1 = (h1 + v) * 0xBF58476D1CE4E5B9ull;
+            h1 ^= h1 >> 31;
+        };
+        for (auto &I : P) {
+            fields(I, mix);
+        }
+        mix(uint64_t(P.size()));
+        return { h0, h1 };
+    }
+}
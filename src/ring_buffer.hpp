@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+#include <iterator>
+
+// Fix kapacitasu gyuru-puffer, mindket vegen O(1) beszurassal es torlessel.
+//
+// A std::deque-vel ellentetben a reset() nem szabaditja fel a tarolot, igy
+// ha ugyanazt a puffert ujrahasznositjuk, a muveletek nem foglalnak
+// memoriat. A kapacitast tullepni nem szabad.
+template<typename T>
+class ring_buffer {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T *;
+        using reference = T &;
+
+        iterator() = default;
+        iterator(ring_buffer *buf, difference_type idx) : _buf(buf), _idx(idx) {}
+
+        reference operator*() const { return (*_buf)[_idx]; }
+        pointer operator->() const { return &(*_buf)[_idx]; }
+        reference operator[](difference_type n) const { return (*_buf)[_idx + n]; }
+
+        iterator &operator++() { _idx++; return *this; }
+        iterator operator++(int) { auto ret = *this; _idx++; return ret; }
+        iterator &operator--() { _idx--; return *this; }
+        iterator operator--(int) { auto ret = *this; _idx--; return ret; }
+        iterator &operator+=(difference_type n) { _idx += n; return *this; }
+        iterator &operator-=(difference_type n) { _idx -= n; return *this; }
+        iterator operator+(difference_type n) const { return { _buf, _idx + n }; }
+        iterator operator-(difference_type n) const { return { _buf, _idx - n }; }
+        friend iterator operator+(difference_type n, iterator const &it) { return it + n; }
+        difference_type operator-(iterator const &other) const { return _idx - other._idx; }
+
+        bool operator==(iterator const &other) const { return _idx == other._idx; }
+        bool operator!=(iterator const &other) const { return _idx != other._idx; }
+        bool operator<(iterator const &other) const { return _idx < other._idx; }
+        bool operator>(iterator const &other) const { return _idx > other._idx; }
+        bool operator<=(iterator const &other) const { return _idx <= other._idx; }
+        bool operator>=(iterator const &other) const { return _idx >= other._idx; }
+
+    private:
+        ring_buffer *_buf = nullptr;
+        difference_type _idx = 0;
+    };
+
+    // Kiuriti a puffert es legalabb `capacity` elemnyi helyet biztosit
+    void reset(size_t capacity) {
+        if (_data.size() < capacity) {
+            _data.resize(capacity);
+        }
+        _head = 0;
+        _size = 0;
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    size_t capacity() const { return _data.size(); }
+
+    T &operator[](size_t i) { return _data[wrap(_head + i)]; }
+    T const &operator[](size_t i) const { return _data[wrap(_head + i)]; }
+
+    T &front() { return (*this)[0]; }
+    T &back() { return (*this)[_size - 1]; }
+
+    void push_back(T const &value) {
+        assert(_size < _data.size());
+        _data[wrap(_head + _size)] = value;
+        _size++;
+    }
+
+    void push_front(T const &value) {
+        assert(_size < _data.size());
+        _head = _head == 0 ? _data.size() - 1 : _head - 1;
+        _data[_head] = value;
+        _size++;
+    }
+
+    void pop_front() {
+        assert(_size > 0);
+        _head = wrap(_head + 1);
+        _size--;
+    }
+
+    void pop_back() {
+        assert(_size > 0);
+        _size--;
+    }
+
+    iterator begin() { return { this, 0 }; }
+    iterator end() { return { this, std::ptrdiff_t(_size) }; }
+
+private:
+    size_t wrap(size_t i) const {
+        return i >= _data.size() ? i - _data.size() : i;
+    }
+
+private:
+    std::vector<T> _data;
+    size_t _head = 0;
+    size_t _size = 0;
+};
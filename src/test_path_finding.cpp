@@ -0,0 +1,246 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "path_finding_program.hpp"
+#include "maze_io.hpp"
+
+using pfp = path_finding_program;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fprintf(stderr, "\n");                              \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+// Palya szovegbol (a felso sor elol, mint a palyafajlokban)
+struct text_level {
+    std::vector<pfp::level_tile> tiles;
+    pfp::level level;
+
+    text_level(std::vector<char const *> const &rows) {
+        auto width = int(strlen(rows[0]));
+        for (auto row : rows) {
+            for (int x = 0; x < width; x++) {
+                switch (row[x]) {
+                case '#': tiles.push_back(pfp::TILE_WALL); break;
+                case 'S': tiles.push_back(pfp::TILE_START); break;
+                case 'X': tiles.push_back(pfp::TILE_EXIT); break;
+                default: tiles.push_back(pfp::TILE_EMPTY); break;
+                }
+            }
+        }
+        level = { tiles.data(), width, int(rows.size()) };
+    }
+};
+
+// Az eredeti interpreter a nyers palyan: a palyan kivul minden fal, a bump
+// jelzo az elso utasitas utan kerul kiszamolasra
+static pfp::program_state reference_execute(pfp::level const &L, pfp::program const &P) {
+    auto sample = [&](int x, int y) {
+        if (x < 0 || x >= L.width || y < 0 || y >= L.height) {
+            return pfp::TILE_WALL;
+        }
+        return L.tiles[(L.height - 1 - y) * L.width + x];
+    };
+
+    pfp::program_state state;
+    for (int y = 0; y < L.height; y++) {
+        for (int x = 0; x < L.width; x++) {
+            if (sample(x, y) == pfp::TILE_START) {
+                state.x = x;
+                state.y = y;
+            }
+        }
+    }
+
+    while (state.steps < 1000 && state.pc >= 0 && state.pc < int(P.size())) {
+        auto &instr = P[state.pc];
+        state.steps++;
+
+        auto next_pc = state.pc + 1;
+        switch (instr.op) {
+        case pfp::OP_RELJMP:
+            next_pc = state.pc + instr.param;
+            break;
+        case pfp::OP_MOVFWD:
+            if (!state.flag_bump) {
+                state.x += state.dx;
+                state.y += state.dy;
+            }
+            break;
+        case pfp::OP_LTURN: {
+            int dx = -state.dy;
+            state.dy = state.dx;
+            state.dx = dx;
+            break;
+        }
+        case pfp::OP_RTURN: {
+            int dx = state.dy;
+            state.dy = -state.dx;
+            state.dx = dx;
+            break;
+        }
+        case pfp::OP_SKIPWALL:
+            if (state.flag_bump) {
+                next_pc = state.pc + 2;
+            }
+            break;
+        default:
+            break;
+        }
+
+        state.flag_exit = sample(state.x, state.y) == pfp::TILE_EXIT;
+        state.flag_bump = sample(state.x + state.dx, state.y + state.dy) == pfp::TILE_WALL;
+        state.pc = next_pc;
+        if (state.flag_exit) {
+            break;
+        }
+    }
+
+    return state;
+}
+
+static bool same_position(pfp::program_state const &a, pfp::program_state const &b) {
+    return a.x == b.x && a.y == b.y && a.dx == b.dx && a.dy == b.dy && a.flag_exit == b.flag_exit;
+}
+
+static void check_program(char const *name, pfp &problem, pfp::level const &L, pfp::program const &P) {
+    auto expected = reference_execute(L, P);
+    auto scalar = problem.execute_program(P, [](int, int) {});
+    auto vm = problem.execute_translated(P);
+    std::vector<pfp::snapshot> snapshots;
+    auto snapshotted = problem.execute_snapshotted(P, snapshots);
+
+    CHECK(same_position(scalar, expected), "%s: scalar (%d, %d) expected (%d, %d)", name, scalar.x, scalar.y, expected.x, expected.y);
+    CHECK(same_position(vm, expected), "%s: vm (%d, %d) expected (%d, %d)", name, vm.x, vm.y, expected.x, expected.y);
+    CHECK(same_position(snapshotted, expected), "%s: snapshotted (%d, %d) expected (%d, %d)", name, snapshotted.x, snapshotted.y, expected.x, expected.y);
+}
+
+// A start es a kijarat a palya szelen: az elso lepes a falkeretre visz,
+// ahonnan a programnak nem szabad tovabbmennie
+static void test_edges() {
+    std::vector<std::vector<char const *>> levels = {
+        {
+            "#X  ",
+            "#  S",
+            "####",
+        },
+        {
+            "##  S",
+            "#   #",
+            "#   X",
+            "#####",
+        },
+        {
+            "#   X",
+            "# # #",
+            "#S  #",
+            "#####",
+        },
+    };
+
+    auto fwd = pfp::instruction{ pfp::OP_MOVFWD, 0 };
+    auto lturn = pfp::instruction{ pfp::OP_LTURN, 0 };
+    auto rturn = pfp::instruction{ pfp::OP_RTURN, 0 };
+
+    for (auto &rows : levels) {
+        text_level T(rows);
+        pfp problem(&T.level);
+
+        check_program("fwd x3", problem, T.level, { fwd, fwd, fwd });
+        check_program("fwd lturn fwd", problem, T.level, { fwd, lturn, fwd, fwd });
+        check_program("fwd back", problem, T.level, { fwd, lturn, lturn, fwd, fwd });
+        check_program("up", problem, T.level, { lturn, fwd, fwd, rturn, fwd, fwd });
+
+        for (int i = 0; i < 20000; i++) {
+            check_program("random", problem, T.level, problem.random_program());
+        }
+    }
+}
+
+static bool same_state(pfp::program_state const &a, pfp::program_state const &b) {
+    return same_position(a, b) && a.flag_bump == b.flag_bump && a.pc == b.pc && a.steps == b.steps;
+}
+
+// A tiled es a morton elrendezes ugyanazt a palyat tarolja, mint a
+// soronkenti: ugyanazok a cellak (a kiegeszitessel egyutt), ugyanaz a
+// tavolsagmezo, es a programok ugyanugy futnak rajtuk
+static void test_layouts() {
+    std::vector<maze_io::maze> mazes = {
+        maze_io::generate(5, 3, 1),
+        maze_io::generate(37, 301, 2),
+        maze_io::generate(300, 45, 3, { 20, 8 }),
+        maze_io::generate(513, 513, 4, { 200, 12 }),
+    };
+    text_level edges({ "#X  ", "#  S", "####" });
+
+    std::vector<pfp::level> levels;
+    for (auto &m : mazes) {
+        levels.push_back(m.level());
+    }
+    levels.push_back(edges.level);
+
+    maze_layout const layouts[] = { maze_layout::tiled, maze_layout::morton };
+    char const *const layout_names[] = { "tiled", "morton" };
+
+    for (auto &L : levels) {
+        auto tile = [&](int x, int y) {
+            auto t = L.tiles[(L.height - 1 - y) * L.width + x];
+            return t == pfp::TILE_WALL ? maze_grid::WALL : t == pfp::TILE_EXIT ? maze_grid::EXIT : uint8_t(0);
+        };
+        maze_grid reference(L.width, L.height, tile);
+        auto reference_distance = reference.distances_from(0, 0);
+        pfp reference_problem(std::vector<pfp::level const *>{ &L }, 1);
+
+        for (int l = 0; l < 2; l++) {
+            auto name = layout_names[l];
+            maze_grid grid(L.width, L.height, tile, layouts[l]);
+            auto distance = grid.distances_from(0, 0);
+            int bad_cells = 0;
+            for (int y = -1; y <= L.height; y++) {
+                for (int x = -1; x <= L.width; x++) {
+                    auto a = reference.index(x, y);
+                    auto b = grid.index(x, y);
+                    bad_cells += reference[a] != grid[b] || reference_distance[a] != distance[b];
+                }
+            }
+            CHECK(bad_cells == 0, "%s %dx%d: %d cells differ", name, L.width, L.height, bad_cells);
+
+            pfp problem(std::vector<pfp::level const *>{ &L }, 1, layouts[l]);
+            for (int i = 0; i < 5000; i++) {
+                auto P = reference_problem.random_program();
+                auto expected = reference_problem.execute_translated(P);
+                auto scalar = problem.execute_program(P, [](int, int) {});
+                auto vm = problem.execute_translated(P);
+                std::vector<pfp::snapshot> snapshots;
+                auto snapshotted = problem.execute_snapshotted(P, snapshots);
+                CHECK(same_state(scalar, expected), "%s %dx%d: scalar (%d, %d) expected (%d, %d)", name, L.width, L.height, scalar.x, scalar.y, expected.x, expected.y);
+                CHECK(same_state(vm, expected), "%s %dx%d: vm (%d, %d) expected (%d, %d)", name, L.width, L.height, vm.x, vm.y, expected.x, expected.y);
+                CHECK(same_state(snapshotted, expected), "%s %dx%d: snapshotted (%d, %d) expected (%d, %d)", name, L.width, L.height, snapshotted.x, snapshotted.y, expected.x, expected.y);
+                CHECK(problem.fitness(vm) == reference_problem.fitness(expected), "%s %dx%d: fitness differs", name, L.width, L.height);
+            }
+        }
+    }
+}
+
+int main() {
+    test_edges();
+    test_layouts();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Egyszeru, allando meretu szalkeszlet parhuzamos ciklusokhoz.
+//
+// A parallel_for a [0, count) tartomanyt `grain` meretu darabokra bontja,
+// amelyeket a munkaszalak es a hivo szal egy kozos szamlalobol vesznek
+// ki; a hivas akkor ter vissza, ha minden darab elkeszult. Egyszerre csak
+// egy szal hivhatja, es a fuggveny nem hivhat ujabb parallel_for-t.
+class thread_pool {
+public:
+    // `n_threads`: a resztvevo szalak szama a hivoval egyutt (0 = annyi,
+    // ahany hardveres szal van, 1 = minden a hivo szalon fut)
+    explicit thread_pool(unsigned n_threads = 0) {
+        if (n_threads == 0) {
+            n_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 1; i < n_threads; i++) {
+            _workers.emplace_back([this, i]() { run(i); });
+        }
+    }
+
+    thread_pool(thread_pool const &) = delete;
+    thread_pool &operator=(thread_pool const &) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _wake.notify_all();
+        for (auto &t : _workers) {
+            t.join();
+        }
+    }
+
+    // A resztvevo szalak szama (a hivoval egyutt)
+    unsigned size() const {
+        return unsigned(_workers.size()) + 1;
+    }
+
+    // fn(begin, end, worker) minden darabra; `worker` a vegrehajto szal
+    // indexe a [0, size()) tartomanyban (a hivo a 0.)
+    template<typename Fn>
+    void parallel_for(size_t count, size_t grain, Fn const &fn) {
+        if (count == 0) {
+            return;
+        }
+        grain = std::max(grain, size_t(1));
+        if (_workers.empty() || count <= grain) {
+            fn(size_t(0), count, 0u);
+            return;
+        }
+
+        std::function<void(unsigned)> job = [&](unsigned worker) {
+            while (true) {
+                auto begin = _next.fetch_add(grain);
+                if (begin >= count) {
+                    break;
+                }
+                fn(begin, std::min(count, begin + grain), worker);
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _job = &job;
+            _next = 0;
+            _pending = _workers.size();
+            _generation++;
+        }
+        _wake.notify_all();
+
+        job(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&]() { return _pending == 0; });
+        _job = nullptr;
+    }
+
+private:
+    void run(unsigned worker) {
+        uint64_t seen = 0;
+        while (true) {
+            std::function<void(unsigned)> *job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&]() { return _quit || _generation != seen; });
+                if (_quit) {
+                    return;
+                }
+                seen = _generation;
+                job = _job;
+            }
+
+            (*job)(worker);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_pending == 0) {
+                    _done.notify_one();
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::function<void(unsigned)> *_job = nullptr;
+    std::atomic<size_t> _next = 0;
+    size_t _pending = 0;
+    uint64_t _generation = 0;
+    bool _quit = false;
+};
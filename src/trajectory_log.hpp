@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <condition_variable>
+
+// Tomor binaris trajektoria-naplo TSP utvonalakhoz.
+//
+// Egy fajlba kerul a teljes futas: a fejlecben a varosok koordinatai, utana
+// generacionkent egy-egy utvonal. Az utvonalak delta-kodoltak: az egymas
+// utani varosindexek kulonbseget zigzag + LEB128 varint formaban taroljuk.
+//
+// Fajlformatum (little-endian):
+//   fejlec: "TSPT", u32 verzio, u32 varosok szama, varosonkent f32 x, f32 y
+//   keret:  u32 generacio, u32 utvonal hossza, hossz darab varint delta
+namespace trajectory {
+    constexpr char magic[4] = { 'T', 'S', 'P', 'T' };
+    constexpr uint32_t version = 1;
+
+    struct frame {
+        uint32_t generation;
+        std::vector<uint32_t> tour;
+    };
+
+    inline void put_u32(std::vector<uint8_t> &buf, uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            buf.push_back(uint8_t(v >> (8 * i)));
+        }
+    }
+
+    inline void put_varint(std::vector<uint8_t> &buf, uint64_t v) {
+        while (v >= 0x80) {
+            buf.push_back(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+        buf.push_back(uint8_t(v));
+    }
+
+    inline uint64_t zigzag(int64_t v) {
+        return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t v) {
+        return int64_t(v >> 1) ^ -int64_t(v & 1);
+    }
+
+    inline void encode_frame(std::vector<uint8_t> &buf, frame const &f) {
+        put_u32(buf, f.generation);
+        put_u32(buf, uint32_t(f.tour.size()));
+        int64_t prev = 0;
+        for (auto idx : f.tour) {
+            put_varint(buf, zigzag(int64_t(idx) - prev));
+            prev = idx;
+        }
+    }
+
+    // Hatterszalon futo iro. A push() csak bemasolja az utvonalat egy korlatos
+    // sorba, a kodolas es a lemezre iras a hatterszalon tortenik, igy a
+    // megoldo szalat nem allitja meg az I/O.
+    //
+    // Ha a sor megtelt, a keretet eldobjuk (es szamoljuk), ahelyett hogy a
+    // megoldot megvarakoztatnank.
+    class writer {
+    public:
+        writer(char const *path, std::vector<std::pair<float, float>> const &positions, size_t capacity = 64)
+            : _capacity(capacity) {
+            _file = fopen(path, "wb");
+            if (_file == nullptr) {
+                fprintf(stderr, "trajectory::writer: failed to open '%s' for writing\n", path);
+                return;
+            }
+
+            std::vector<uint8_t> header;
+            header.insert(header.end(), std::begin(magic), std::end(magic));
+            put_u32(header, version);
+            put_u32(header, uint32_t(positions.size()));
+            for (auto &pos : positions) {
+                uint32_t x, y;
+                memcpy(&x, &pos.first, 4);
+                memcpy(&y, &pos.second, 4);
+                put_u32(header, x);
+                put_u32(header, y);
+            }
+            fwrite(header.data(), 1, header.size(), _file);
+
+            _thread = std::thread([this]() { run(); });
+        }
+
+        writer(writer const &) = delete;
+        writer &operator=(writer const &) = delete;
+
+        ~writer() {
+            if (_file == nullptr) {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cv.notify_one();
+            _thread.join();
+            fclose(_file);
+        }
+
+        // Sorba allit egy utvonalat. Hamissal ter vissza, ha a sor tele volt
+        // es a keretet eldobtuk.
+        template<typename Path>
+        bool push(int generation, Path const &tour) {
+            if (_file == nullptr) {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_queue.size() >= _capacity) {
+                _dropped++;
+                return false;
+            }
+
+            // A mar kiirt keretek puffereit ujrahasznositjuk
+            frame f;
+            if (!_free.empty()) {
+                f = std::move(_free.back());
+                _free.pop_back();
+            }
+            lock.unlock();
+
+            f.generation = uint32_t(generation);
+            f.tour.assign(tour.begin(), tour.end());
+
+            lock.lock();
+            _queue.push_back(std::move(f));
+            lock.unlock();
+            _cv.notify_one();
+            return true;
+        }
+
+        size_t dropped() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _dropped;
+        }
+
+    private:
+        void run() {
+            std::vector<uint8_t> buf;
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                _cv.wait(lock, [&]() { return _stop || !_queue.empty(); });
+                if (_queue.empty()) {
+                    break;
+                }
+
+                auto f = std::move(_queue.front());
+                _queue.pop_front();
+                lock.unlock();
+
+                buf.clear();
+                encode_frame(buf, f);
+                fwrite(buf.data(), 1, buf.size(), _file);
+
+                lock.lock();
+                _free.push_back(std::move(f));
+            }
+
+            fflush(_file);
+        }
+
+    private:
+        FILE *_file = nullptr;
+        size_t _capacity;
+        size_t _dropped = 0;
+        bool _stop = false;
+
+        std::deque<frame> _queue;
+        std::vector<frame> _free;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        std::thread _thread;
+    };
+
+    // A trajektoria-fajl olvasoja, az offline konverterhez
+    class reader {
+    public:
+        reader(char const *path) {
+            _file = fopen(path, "rb");
+            if (_file == nullptr) {
+                fprintf(stderr, "trajectory::reader: failed to open '%s' for reading\n", path);
+                return;
+            }
+
+            char m[4];
+            uint32_t ver, n_cities;
+            if (fread(m, 1, 4, _file) != 4 || memcmp(m, magic, 4) != 0 || !get_u32(ver) || ver != version || !get_u32(n_cities)) {
+                fprintf(stderr, "trajectory::reader: '%s' is not a trajectory file\n", path);
+                fclose(_file);
+                _file = nullptr;
+                return;
+            }
+
+            _positions.resize(n_cities);
+            for (auto &pos : _positions) {
+                uint32_t x, y;
+                if (!get_u32(x) || !get_u32(y)) {
+                    fclose(_file);
+                    _file = nullptr;
+                    return;
+                }
+                memcpy(&pos.first, &x, 4);
+                memcpy(&pos.second, &y, 4);
+            }
+        }
+
+        reader(reader const &) = delete;
+        reader &operator=(reader const &) = delete;
+
+        ~reader() {
+            if (_file != nullptr) {
+                fclose(_file);
+            }
+        }
+
+        bool is_open() const {
+            return _file != nullptr;
+        }
+
+        std::vector<std::pair<float, float>> const &positions() const {
+            return _positions;
+        }
+
+        // Beolvassa a kovetkezo keretet; hamissal ter vissza a fajl vegen,
+        // illetve csonka vagy serult fajl eseten. A keret minden indexe
+        // kisebb a varosok szamanal: a hibas indexu kereteket kihagyjuk (es
+        // szamoljuk, lasd rejected).
+        bool next(frame &f) {
+            while (true) {
+                uint32_t len;
+                if (_file == nullptr || !get_u32(f.generation) || !get_u32(len)) {
+                    return false;
+                }
+                // Egy utvonal minden varost legfeljebb egyszer erint; a
+                // hosszabb keret utan a fajl tobbi resze sem megbizhato
+                if (len > _positions.size()) {
+                    fprintf(stderr, "trajectory::reader: frame of generation %u has %u cities, more than the %zu in the header\n",
+                        f.generation, len, _positions.size());
+                    return false;
+                }
+
+                f.tour.resize(len);
+                int64_t prev = 0;
+                bool valid = true;
+                for (auto &idx : f.tour) {
+                    uint64_t v;
+                    if (!get_varint(v)) {
+                        fprintf(stderr, "trajectory::reader: truncated frame of generation %u\n", f.generation);
+                        return false;
+                    }
+                    prev += unzigzag(v);
+                    valid = valid && prev >= 0 && uint64_t(prev) < _positions.size();
+                    idx = uint32_t(prev);
+                }
+                if (valid) {
+                    return true;
+                }
+
+                fprintf(stderr, "trajectory::reader: frame of generation %u has a city index out of range, skipping it\n", f.generation);
+                _rejected++;
+            }
+        }
+
+        // A hibas indexek miatt kihagyott keretek szama
+        size_t rejected() const {
+            return _rejected;
+        }
+
+    private:
+        bool get_u32(uint32_t &v) {
+            uint8_t b[4];
+            if (fread(b, 1, 4, _file) != 4) {
+                return false;
+            }
+            v = uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24);
+            return true;
+        }
+
+        bool get_varint(uint64_t &v) {
+            v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                auto ch = fgetc(_file);
+                if (ch == EOF) {
+                    return false;
+                }
+                v |= uint64_t(ch & 0x7F) << shift;
+                if ((ch & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        FILE *_file = nullptr;
+        std::vector<std::pair<float, float>> _positions;
+        size_t _rejected = 0;
+    };
+}
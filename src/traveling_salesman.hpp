@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <cmath>
 #include <utility>
 #include <vector>
 #include <algorithm>
@@ -9,18 +10,79 @@
 #include <random>
 #include <functional>
 #include <iterator>
-
-template<typename City>
+#include <limits>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <chrono>
+
+#include "two_level_tour.hpp"
+#include "held_karp.hpp"
+
+// Az utvonalakban tarolt varosindex tipusa. Nagy peldanyoknal a populacio
+// memoriaigenyet (es a total_distance/crossover savszelesseget) a keskenyebb
+// tipusok felere-negyedere csokkentik.
+//
+// `Index` lehet size_t, uint32_t vagy uint16_t; a konstruktor ellenorzi, hogy
+// a varosok szama abrazolhato-e vele.
+template<typename City, typename Index = size_t>
 class traveling_salesman {
 public:
-    using path = std::vector<size_t>;
+    using index = Index;
+    using path = std::vector<Index>;
     using solution = path;
     using population = std::vector<path>;
-    using solution_with_fitness = std::pair<path, float>;
-    using evaluated_population = std::vector<solution_with_fitness>;
+
+    // Egy kiertekelt megoldas: a fitness es a megoldas indexe a forras
+    // populacioban. Rendezeskor csak ezt a 8 bajtot mozgatjuk, az utvonalakat
+    // nem.
+    struct fitness_record {
+        float fitness;
+        uint32_t index;
+    };
+    using solution_with_fitness = fitness_record;
+
+    // Kiertekelt populacio. Az utvonalakat nem masolja, hanem index alapjan
+    // a forras populaciobol eri el, ezert a forras populacionak tul kell
+    // elnie a kiertekelt populaciot.
+    //
+    // Csak az elso `n_sorted` rekord (az elit) rendezett fitness szerint,
+    // a tobbi sorrendje tetszoleges.
+    struct evaluated_population {
+        population const *source = nullptr;
+        std::vector<fitness_record> records;
+        size_t n_sorted = 0;
+        float average = 0;
+
+        path const &solution(size_t i) const {
+            return (*source)[records[i].index];
+        }
+
+        float fitness(size_t i) const {
+            return records[i].fitness;
+        }
+
+        auto end() {
+            return records.end();
+        }
+
+        auto insert(typename std::vector<fitness_record>::iterator it, fitness_record const &r) {
+            return records.insert(it, r);
+        }
+
+        friend size_t size(evaluated_population const &pop) {
+            return pop.records.size();
+        }
+    };
 
     traveling_salesman(std::vector<City> cities, size_t start_idx)
         : _cities(std::move(cities)), _start_idx(start_idx) {
+        assert(fits_index(_cities.size()));
+    }
+
+    // Elfer-e `n_cities` darab varos indexe az `Index` tipusban?
+    static constexpr bool fits_index(size_t n_cities) {
+        return n_cities == 0 || n_cities - 1 <= size_t(std::numeric_limits<Index>::max());
     }
 
     population init_population() {
@@ -31,10 +93,11 @@ public:
         // Sablon utvonal, ahol a kiindulasi ponttol kezdve sorban
         // bejarjuk a varosokat
         path p_template;
-        p_template.push_back(_start_idx);
+        p_template.reserve(n_cities);
+        p_template.push_back(Index(_start_idx));
         for (size_t city_idx = 0; city_idx < n_cities; city_idx++) {
             if (city_idx != _start_idx) {
-                p_template.push_back(city_idx);
+                p_template.push_back(Index(city_idx));
             }
         }
 
@@ -67,33 +130,46 @@ public:
 
     evaluated_population evaluate(population const &pop) {
         evaluated_population ret;
-        std::transform(
-            pop.begin(), pop.end(),
-            std::back_inserter(ret),
-            [&](solution const &s) {
-                return std::make_pair(s, total_distance(s));
-            }
+        auto N = pop.size();
+
+        ret.source = &pop;
+        ret.records.resize(N);
+
+        float sum = 0;
+        for (size_t i = 0; i < N; i++) {
+            auto f = total_distance(pop[i]);
+            ret.records[i] = { f, uint32_t(i) };
+            sum += f;
+        }
+        ret.average = N > 0 ? sum / N : 0;
+
+        // A select_next_gen-nek csak az elit kell sorrendben, a find_best_in-nek
+        // pedig a legjobb megoldas, ezert eleg reszlegesen rendezni
+        ret.n_sorted = std::min(N, std::max(size_t(1), elite_count(N)));
+        std::partial_sort(
+            ret.records.begin(), ret.records.begin() + ret.n_sorted, ret.records.end(),
+            [](fitness_record const &lhs, fitness_record const &rhs) { return lhs.fitness < rhs.fitness; }
         );
-        std::sort(ret.begin(), ret.end(), [](auto &lhs, auto &rhs) { return lhs.second < rhs.second; });
+
         return ret;
     }
 
-    float average_fitness(evaluated_population const &pop) {
-        float sum = 0;
-        int n = 0;
+    // A kiertekelt populacio nem masolja a megoldasokat, ezert ideiglenes
+    // populaciot nem ertekelhetunk ki
+    evaluated_population evaluate(population &&pop) = delete;
 
-        for (auto &sf : pop) {
-            sum += sf.second;
-            n++;
-        }
+    float average_fitness(evaluated_population const &pop) {
+        return pop.average;
+    }
 
-        return sum / n;
+    static size_t elite_count(size_t n_solutions) {
+        return n_solutions / 8;
     }
 
     std::pair<population, population>
         select_next_gen(evaluated_population const &pop) {
-        auto n_solutions = pop.size();
-        auto n_elite = n_solutions / 8;
+        auto n_solutions = size(pop);
+        auto n_elite = elite_count(n_solutions);
 
         population elite;
         population mating;
@@ -102,11 +178,11 @@ public:
 
         for (size_t i = 0; i < n_solutions; i++) {
             if (i < n_elite) {
-                elite.push_back(pop[i].first);
-                mating.push_back(pop[i].first);
+                elite.push_back(pop.solution(i));
+                mating.push_back(pop.solution(i));
             } else {
-                if (pop[i].second >= avg_fit) {
-                    mating.push_back(pop[i].first);
+                if (pop.fitness(i) >= avg_fit) {
+                    mating.push_back(pop.solution(i));
                 }
             }
         }
@@ -116,7 +192,7 @@ public:
 
     population select_parents(evaluated_population &pop) {
         auto k = 16;
-        auto N = pop.size();
+        auto N = size(pop);
         std::vector<size_t> parent_indices;
 
         std::uniform_int_distribution<size_t> dist_index(0, N - 1);
@@ -136,7 +212,7 @@ public:
                     contender = generate_random_index();
                 }
 
-                if (pop[subject_idx].second < pop[contender].second) {
+                if (pop.fitness(subject_idx) < pop.fitness(contender)) {
                     duels_won++;
                 }
                 duels_played++;
@@ -152,7 +228,7 @@ public:
         std::transform(
             parent_indices.begin(), parent_indices.end(),
             std::back_inserter(ret),
-            [&](auto i) { return pop[i].first; }
+            [&](auto i) { return pop.solution(i); }
         );
         return ret;
     }
@@ -163,6 +239,7 @@ public:
         auto &p1 = pop[1];
 
         auto N = p0.size();
+        ret.reserve(N);
 
         std::uniform_int_distribution<size_t> dist_index(0, N - 1);
         auto generate_random_index = std::bind(dist_index, _rand);
@@ -175,10 +252,8 @@ public:
         std::uniform_int_distribution<size_t> dist_sequence_size(0, N - first - 1);
         auto last = first + dist_sequence_size(_rand);
 
-        assert(first >= 0 && first < N);
-        assert(last >= 0 && last < N);
-        assert(last - first >= 0);
-        assert(last - first <= N);
+        assert(first < N);
+        assert(first <= last && last < N);
 
         auto p0_first = p0.begin() + first;
         auto p0_end = p0.begin() + last + 1;
@@ -215,7 +290,7 @@ public:
 
 #define CROSSOVER_SANITY_CHECK 0
 #if CROSSOVER_SANITY_CHECK
-        std::unordered_set<size_t> sanchk;
+        std::unordered_set<Index> sanchk;
         for (auto idx : ret) {
             if (sanchk.count(idx)) {
                 __debugbreak();
@@ -237,17 +312,328 @@ public:
             auto i1 = rand() % N;
             std::swap(p[i0], p[i1]);
         }
+
+        if (_local_search_moves > 0) {
+            improve(p);
+        }
+    }
+
+    // Bekapcsolja a 2-opt lokalis keresest a mutacio utan; legfeljebb
+    // `max_moves` javito lepest tesz utvonalankent. 0 kikapcsolja.
+    void set_local_search(size_t max_moves, size_t n_neighbors = 8) {
+        _local_search_moves = max_moves;
+        if (max_moves > 0 && _n_neighbors != n_neighbors) {
+            build_candidates(n_neighbors);
+        }
+    }
+
+    // Minden varoshoz a hozza legkozelebbi `n_neighbors` varos indexe,
+    // tavolsag szerint novekvo sorrendben; az i. varose a
+    // [i * n, (i + 1) * n) tartomanyban van.
+    std::vector<Index> const &candidates() const {
+        return _neighbors;
+    }
+
+    size_t candidates_per_city() const {
+        return _n_neighbors;
+    }
+
+    void build_candidates(size_t n_neighbors) {
+        _n_neighbors = _cities.size() > 0 ? std::min(n_neighbors, _cities.size() - 1) : 0;
+        _neighbors = compute_candidates(_cities, _n_neighbors);
+    }
+
+    // Ha a City-nek x, y koordinatai vannak (es a distance euklideszi), a
+    // szomszedokat egy egyenletes racsbol keressuk, ami O(N k log k);
+    // kulonben minden parra kiszamoljuk a tavolsagot (O(N^2 log k)). Az
+    // eredmeny mindket esetben ugyanaz: egyenlo tavolsagnal a kisebb index
+    // van elobb.
+    static std::vector<Index> compute_candidates(std::vector<City> const &cities, size_t n_neighbors) {
+        if constexpr (requires(City const &c) { float(c.x); float(c.y); }) {
+            return compute_candidates_grid(cities, n_neighbors);
+        }
+
+        auto N = cities.size();
+        std::vector<Index> ret(N * n_neighbors);
+
+        std::vector<std::pair<float, Index>> buf;
+        for (size_t i = 0; i < N; i++) {
+            buf.clear();
+            for (size_t j = 0; j < N; j++) {
+                if (i != j) {
+                    buf.emplace_back(distance(cities[i], cities[j]), Index(j));
+                }
+            }
+            std::partial_sort(buf.begin(), buf.begin() + n_neighbors, buf.end());
+            for (size_t k = 0; k < n_neighbors; k++) {
+                ret[i * n_neighbors + k] = buf[k].second;
+            }
+        }
+
+        return ret;
+    }
+
+    // A compute_candidates racsos valtozata. A racs cellaiban atlagosan ket
+    // varos van; egy varos szomszedait a sajat cellajatol kifele, cellagyuruk
+    // szerint keressuk, es megallunk, ha mar megvan `n_neighbors` jelolt, es
+    // a kovetkezo gyuru minden varosa messzebb van a leggyengebbnel.
+    static std::vector<Index> compute_candidates_grid(std::vector<City> const &cities, size_t n_neighbors) {
+        auto N = cities.size();
+        std::vector<Index> ret(N * n_neighbors);
+        if (N == 0 || n_neighbors == 0) {
+            return ret;
+        }
+
+        auto min_x = float(cities[0].x), max_x = min_x;
+        auto min_y = float(cities[0].y), max_y = min_y;
+        for (auto &c : cities) {
+            min_x = std::min(min_x, float(c.x));
+            max_x = std::max(max_x, float(c.x));
+            min_y = std::min(min_y, float(c.y));
+            max_y = std::max(max_y, float(c.y));
+        }
+
+        // Negyzetes cellak; ha a varosok egy vonalon vannak (a befoglalo
+        // teglalap terulete 0), a cellameret a vonal hosszabol jon
+        auto extent_x = double(max_x) - min_x;
+        auto extent_y = double(max_y) - min_y;
+        auto cell = std::sqrt(extent_x * extent_y * 2 / N);
+        if (!(cell > 0)) {
+            cell = std::max(extent_x, extent_y) * 2 / N;
+        }
+        if (!(cell > 0)) {
+            cell = 1;
+        }
+        auto cells_along = [&](double extent) {
+            return int(std::clamp(std::ceil(extent / cell), 1.0, double(N)));
+        };
+        auto columns = cells_along(extent_x);
+        auto rows = cells_along(extent_y);
+        auto cell_of = [&](City const &c) {
+            auto cx = std::min(columns - 1, int((float(c.x) - min_x) / cell));
+            auto cy = std::min(rows - 1, int((float(c.y) - min_y) / cell));
+            return std::make_pair(cx, cy);
+        };
+
+        // A varosok cellankent (leszamlalo rendezes)
+        std::vector<uint32_t> cell_start(size_t(columns) * rows + 1, 0);
+        std::vector<uint32_t> items(N);
+        for (auto &c : cities) {
+            auto [cx, cy] = cell_of(c);
+            cell_start[size_t(cy) * columns + cx + 1]++;
+        }
+        for (size_t i = 1; i < cell_start.size(); i++) {
+            cell_start[i] += cell_start[i - 1];
+        }
+        {
+            auto fill = cell_start;
+            for (size_t i = 0; i < N; i++) {
+                auto [cx, cy] = cell_of(cities[i]);
+                items[fill[size_t(cy) * columns + cx]++] = uint32_t(i);
+            }
+        }
+
+        // Egy gyurunyi tavolodas legalabb ennyivel noveli a tavolsagot; a
+        // kerekitesi hibak miatt egy kicsit alabecsuljuk
+        auto ring_step = float(cell) * (1 - 1e-4f);
+
+        // Max-kupac a legjobb `n_neighbors` jeloltre
+        std::vector<std::pair<float, Index>> heap;
+        for (size_t i = 0; i < N; i++) {
+            heap.clear();
+            auto [cx, cy] = cell_of(cities[i]);
+
+            auto visit = [&](int x, int y) {
+                if (x < 0 || y < 0 || x >= columns || y >= rows) {
+                    return;
+                }
+                auto c = size_t(y) * columns + x;
+                for (auto k = cell_start[c]; k < cell_start[c + 1]; k++) {
+                    auto j = items[k];
+                    if (j == i) {
+                        continue;
+                    }
+                    std::pair<float, Index> cand(distance(cities[i], cities[j]), Index(j));
+                    if (heap.size() < n_neighbors) {
+                        heap.push_back(cand);
+                        std::push_heap(heap.begin(), heap.end());
+                    } else if (cand < heap.front()) {
+                        std::pop_heap(heap.begin(), heap.end());
+                        heap.back() = cand;
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                }
+            };
+
+            for (int r = 0; r < std::max(columns, rows); r++) {
+                if (heap.size() == n_neighbors && heap.front().first < (r - 1) * ring_step) {
+                    break;
+                }
+                if (r == 0) {
+                    visit(cx, cy);
+                    continue;
+                }
+                for (int d = -r; d <= r; d++) {
+                    visit(cx + d, cy - r);
+                    visit(cx + d, cy + r);
+                }
+                for (int d = -r + 1; d <= r - 1; d++) {
+                    visit(cx - r, cy + d);
+                    visit(cx + r, cy + d);
+                }
+            }
+
+            std::sort_heap(heap.begin(), heap.end());
+            for (size_t k = 0; k < n_neighbors; k++) {
+                ret[i * n_neighbors + k] = heap[k].second;
+            }
+        }
+
+        return ret;
+    }
+
+    // Elinditja a Held-Karp also korlat szamitasat egy hatterszalon. A
+    // peldanyonkent egyszer futo szamitas a varosok masolatan dolgozik.
+    void start_lower_bound(int max_iterations = 200, size_t n_neighbors = 8) {
+        auto cities = _cities;
+        auto start = _start_idx;
+        _lower_bound = std::async(std::launch::async, [cities = std::move(cities), start, max_iterations, n_neighbors]() {
+            auto N = cities.size();
+            auto k = N > 0 ? std::min(n_neighbors, N - 1) : 0;
+            auto candidates = compute_candidates(cities, k);
+            auto cost = [&](size_t i, size_t j) { return distance(cities[i], cities[j]); };
+            return held_karp::path_lower_bound(N, start, cost, candidates, k, max_iterations);
+        }).share();
+    }
+
+    // Az also korlat, vagy NaN, ha meg nem keszult el (vagy el sem indult)
+    float lower_bound() const {
+        if (!_lower_bound.valid() || _lower_bound.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return NAN;
+        }
+        return _lower_bound.get();
+    }
+
+    // A populacio legjobb megoldasanak relativ tavolsaga az also korlattol
+    // (0 = bizonyitottan optimalis); NaN, ha a korlat meg nem ismert
+    float optimality_gap(evaluated_population const &pop) const {
+        auto lb = lower_bound();
+        if (std::isnan(lb) || lb <= 0 || size(pop) == 0) {
+            return NAN;
+        }
+        return (pop.fitness(0) - lb) / lb;
+    }
+
+    // 2-opt lokalis kereses a jelolt szomszedokon.
+    //
+    // Az utvonalat csak itt alakitjuk at ket szintu listava (es vissza), igy
+    // egy javito lepes (szakaszmegforditas) O(sqrt N). Mivel az utvonal nyitott
+    // es a kiindulo varosbol indul, felveszunk egy D = N segedvarost, amely az
+    // utolso varos es a kiindulo varos koze kerul: a D-t erinto elek koltsege
+    // 0, a (D, start) elt pedig sosem bontjuk fel.
+    void improve(path &p) {
+        auto N = p.size();
+        if (N < 4 || _n_neighbors == 0) {
+            return;
+        }
+
+        auto const D = uint32_t(N);
+        auto const start = uint32_t(p[0]);
+
+        std::vector<uint32_t> cycle(p.begin(), p.end());
+        cycle.push_back(D);
+        two_level_tour tour(cycle);
+
+        auto cost = [&](uint32_t a, uint32_t b) -> float {
+            if (a == D || b == D) {
+                return 0;
+            }
+            return distance(_cities[a], _cities[b]);
+        };
+        auto is_fixed = [&](uint32_t a, uint32_t b) {
+            return (a == D && b == start) || (a == start && b == D);
+        };
+
+        std::deque<uint32_t> queue(p.begin(), p.end());
+        std::vector<bool> queued(N + 1, true);
+        queued[D] = false;
+
+        size_t moves = 0;
+        while (!queue.empty() && moves < _local_search_moves) {
+            auto a = queue.front();
+            queue.pop_front();
+            queued[a] = false;
+
+            bool improved = false;
+            for (int forward = 1; forward >= 0 && !improved; forward--) {
+                auto a2 = forward ? tour.next(a) : tour.prev(a);
+                if (is_fixed(a, a2)) {
+                    continue;
+                }
+                auto d_a = cost(a, a2);
+
+                for (size_t k = 0; k < _n_neighbors; k++) {
+                    uint32_t c = _neighbors[a * _n_neighbors + k];
+                    auto d_ac = cost(a, c);
+                    // A szomszedok tavolsag szerint rendezettek, innentol
+                    // mar nem lehet nyereseges a lepes
+                    if (d_ac >= d_a) {
+                        break;
+                    }
+
+                    auto c2 = forward ? tour.next(c) : tour.prev(c);
+                    if (c == a2 || c2 == a || is_fixed(c, c2)) {
+                        continue;
+                    }
+
+                    auto delta = d_ac + cost(a2, c2) - d_a - cost(c, c2);
+                    if (delta < -1e-4f) {
+                        // elore: a a2 ... c c2 -> a c ... a2 c2
+                        // hatra: c2 c ... a2 a -> c2 a2 ... c a
+                        if (forward) {
+                            tour.reverse(a2, c);
+                        } else {
+                            tour.reverse(a, c2);
+                        }
+
+                        for (auto x : { a, a2, c, c2 }) {
+                            if (x != D && !queued[x]) {
+                                queued[x] = true;
+                                queue.push_back(x);
+                            }
+                        }
+                        moves++;
+                        improved = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Vissza tomb alapu utvonalla: a kiindulo varosbol a D-vel ellentetes
+        // iranyba haladunk
+        auto forward = tour.next(start) != D;
+        auto c = start;
+        for (size_t i = 0; i < N; i++) {
+            p[i] = Index(c);
+            c = forward ? tour.next(c) : tour.prev(c);
+        }
     }
 
     path find_best_in(population const &pop) {
         auto pop_fit = evaluate(pop);
-        auto best = pop_fit[0];
-        printf("top fitness: %f | avg fitness: %f\n", best.second, average_fitness(pop_fit));
-        return best.first;
+        printf("top fitness: %f | avg fitness: %f\n", pop_fit.fitness(0), average_fitness(pop_fit));
+        return pop_fit.solution(0);
     }
 
 private:
     std::vector<City> _cities;
     size_t _start_idx;
     std::mt19937 _rand;
+
+    size_t _local_search_moves = 0;
+    size_t _n_neighbors = 0;
+    std::vector<Index> _neighbors;
+
+    std::shared_future<float> _lower_bound;
 };
@@ -1,15 +1,30 @@
 #pragma once
 
+#include <cmath>
+#include <limits>
+#include <cassert>
+#include <cstdint>
 #include <vector>
-#include <deque>
 #include <random>
 #include <iterator>
 #include <functional>
-
-template<typename City>
+#include <algorithm>
+#include <unordered_map>
+#include <queue>
+
+#include "ring_buffer.hpp"
+#include "program_arena.hpp"
+#include "bloat_control.hpp"
+#include "gp_profile.hpp"
+#include "program_hash.hpp"
+#include "tsp_program_jit.hpp"
+
+// `Operand` az utasitasok operandusainak tipusa; a varosok szamanak bele
+// kell fernie (lasd fits_operand).
+template<typename City, typename Operand = uint16_t>
 class traveling_salesman_program {
 public:
-	enum operation {
+	enum operation : uint8_t {
 		OP_RELJMP_NC,
 		OP_PREPEND_NEXT,
 		OP_APPEND_NEXT,
@@ -21,68 +36,171 @@ public:
 		OP_MAX
 	};
 
+	// Tomoritett utasitas: 1 bajtos muveleti kod es ket `Operand` tipusu
+	// operandus (uint16_t eseten 6 bajt). Az operandusokat mar generalaskor
+	// a varosok szama ala redukaljuk.
 	struct instruction {
 		operation op;
-		size_t x, y;
+		Operand x, y;
+
+		friend bool operator==(instruction const &, instruction const &) = default;
 	};
 
+	// Egy kulon allo program (pl. egy keresztezes eredmenye)
 	using program = std::vector<instruction>;
+	// Egy program nem birtokolt nezete; a populaciok es a program is
+	// atadhato igy
+	using program_ref = program_view<instruction>;
 	using solution = program;
-	using population = std::vector<program>;
-	using solution_with_fitness = std::pair<program, float>;
-	using evaluated_population = std::vector<solution_with_fitness>;
+	// A populacio programjai egyetlen arenaban vannak
+	using population = program_arena<instruction>;
+
+	// Egy kiertekelt program: a fitness es a program indexe a forras
+	// populacioban. Rendezeskor csak ezt a 8 bajtot mozgatjuk.
+	struct fitness_record {
+		float fitness;
+		uint32_t index;
+	};
+	using solution_with_fitness = fitness_record;
+
+	// Kiertekelt populacio. A programokat nem masolja, hanem index alapjan
+	// a forras populaciobol eri el, ezert a forras populacionak tul kell
+	// elnie a kiertekelt populaciot. A rekordok fitness szerint rendezettek.
+	struct evaluated_population {
+		population const *source = nullptr;
+		std::vector<fitness_record> records;
+
+		program_ref solution(size_t i) const {
+			return (*source)[records[i].index];
+		}
+
+		float fitness(size_t i) const {
+			return records[i].fitness;
+		}
+
+		auto end() {
+			return records.end();
+		}
+
+		auto insert(typename std::vector<fitness_record>::iterator it, fitness_record const &r) {
+			return records.insert(it, r);
+		}
+
+		friend size_t size(evaluated_population const &pop) {
+			return pop.records.size();
+		}
+	};
 
     traveling_salesman_program(std::vector<City> const &cities, size_t start_idx) : _cities(cities), _start_idx(start_idx) {
+        assert(fits_operand(_cities.size()));
+
+        _bloat.max_length = 4 * program_max_length;
+        _bloat.size_fair = true;
+        _bloat.lexicographic_parsimony = true;
+    }
+
+    void set_bloat_control(genetic::bloat_control const &bc) {
+        _bloat = bc;
+    }
+
+    genetic::bloat_control const &bloat_control() const {
+        return _bloat;
+    }
+
+    // Elfer-e `n_cities` darab varos indexe az `Operand` tipusban?
+    static constexpr bool fits_operand(size_t n_cities) {
+        return n_cities == 0 || n_cities - 1 <= size_t(std::numeric_limits<Operand>::max());
     }
 
 	population init_population() {
 		population ret;
+		ret.reserve(num_min_population, num_min_population * program_max_length);
 
 		for (int i = 0; i < num_min_population; i++) {
-			ret.emplace_back(random_program());
+			ret.insert(ret.end(), random_program());
 		}
 
 		return ret;
 	}
 
+	evaluated_population evaluate(population &&pop) = delete;
+
 	evaluated_population evaluate(population const &pop) {
+		GP_PROFILE_EVALUATION(_profile);
 		evaluated_population ret;
-
-		for (auto &solution : pop) {
-			ret.emplace_back(std::make_pair(solution, fitness(solution)));
+		ret.source = &pop;
+		ret.records.reserve(pop.size());
+
+		// Az eddigi legjobb elite_count darab fitness (max-kupac); ha mar
+		// tele van, a teteje a leggyengebb elit, es az ennel rosszabb
+		// programok futtatasat idoben leallithatjuk
+		auto n_elite = _use_cutoff ? elite_count(pop.size()) : 0;
+		std::priority_queue<float> elite_fitness;
+		auto avg_length = average_length(pop);
+
+		for (size_t i = 0; i < pop.size(); i++) {
+			_cutoff = (n_elite > 0 && elite_fitness.size() == n_elite) ? elite_fitness.top() : INFINITY;
+			// Tarpeian: egyes tul hosszu programokat le sem futtatunk
+			auto f = genetic::tarpeian_hit(pop[i].size(), avg_length, _bloat, _rand) ? INFINITY : fitness(pop[i]);
+			ret.records.push_back({ f, uint32_t(i) });
+
+			if (elite_fitness.size() < n_elite) {
+				elite_fitness.push(f);
+			} else if (n_elite > 0 && f < elite_fitness.top()) {
+				elite_fitness.pop();
+				elite_fitness.push(f);
+			}
 		}
+		_cutoff = INFINITY;
 
-		std::sort(ret.begin(), ret.end(), [](auto &lhs, auto &rhs) { return lhs.second < rhs.second; });
+		std::sort(ret.records.begin(), ret.records.end(), [&](auto &lhs, auto &rhs) {
+			return genetic::fitter(lhs.fitness, pop[lhs.index].size(), rhs.fitness, pop[rhs.index].size(), _bloat);
+		});
 
 		return ret;
 	}
 
-    float fitness(program const &program) {
+    float fitness(program_ref program) {
+        // A programot kanonikus alakjaban futtatjuk, es ez a kulcsa a
+        // fitness gyorsitotarnak is
+        auto &canonical = scratch_program();
+        canonicalize(program, canonical);
+
+        auto key = hash(canonical);
+        auto cached = _fitness_cache.find(key.first);
+        if (cached != _fitness_cache.end() && cached->second.check == key.second) {
+            auto stored = _fitness_cache_programs[cached->second.program];
+            if (std::equal(stored.begin(), stored.end(), canonical.begin(), canonical.end())) {
+                return cached->second.fitness;
+            }
+        }
+
         // exec program
         auto callback = [](int x, int y) {};
-        auto result = execute_program(program, callback);
-
-        if (!result.flag_complete) {
-            return INFINITY;
-        }
-        
-        auto path = result.path;
-        path.push_front(_start_idx);
-        float total_distance = 0;
-        auto N = path.size();
-
-        if (N > 1) {
-            for (size_t i = 0; i < N; i++) {
-                total_distance += distance(
-                    _cities[path[(i + 0)]],
-                    _cities[path[(i + 1) % N]]
-                );
-            }
+        auto &result = execute_program(canonical, callback);
 
-            return total_distance;
-        } else {
-            return INFINITY;
+        // Az utvonal hosszat az interpreter futas kozben szamolja
+        auto ret = INFINITY;
+        if (result.flag_complete && result.path.size() > 0) {
+            ret = float(result.length);
+        }
+
+        // A levagott futas eredmenye a levagasi korlattol fugg, ezt nem
+        // taroljuk el
+        if (!result.cut_off) {
+            if (_fitness_cache.size() >= fitness_cache_max_size ||
+                _fitness_cache_programs.instruction_count() + canonical.size() > fitness_cache_max_instructions) {
+                _fitness_cache.clear();
+                _fitness_cache_programs.clear();
+            }
+            _fitness_cache_programs.push_back(canonical);
+            _fitness_cache[key.first] = { key.second, ret, uint32_t(_fitness_cache_programs.size() - 1) };
         }
+        return ret;
+    }
+
+    static float average_length(population const &pop) {
+        return size(pop) == 0 ? 0 : float(pop.instruction_count()) / size(pop);
     }
 
     float average_fitness(evaluated_population const &pop) {
@@ -90,8 +208,8 @@ public:
         float sum = 0;
         int n = 0;
 
-        for (auto &sf : pop) {
-            sum += sf.second;
+        for (auto &r : pop.records) {
+            sum += r.fitness;
             n++;
         }
 
@@ -100,8 +218,8 @@ public:
 
     std::pair<population, population> select_next_gen(evaluated_population const &pop) {
         // TODO: ugyanaz, mint a traveling_salesman-ben
-        auto n_solutions = pop.size();
-        auto n_elite = n_solutions / 8;
+        auto n_solutions = size(pop);
+        auto n_elite = elite_count(n_solutions);
 
         population elite;
         population mating;
@@ -110,18 +228,18 @@ public:
 
         for (size_t i = 0; i < n_solutions; i++) {
             if (i < n_elite) {
-                elite.push_back(pop[i].first);
-                mating.push_back(pop[i].first);
+                elite.push_back(pop.solution(i));
+                mating.push_back(pop.solution(i));
             } else {
-                if (pop[i].second >= avg_fit) {
-                    mating.push_back(pop[i].first);
+                if (pop.fitness(i) >= avg_fit) {
+                    mating.push_back(pop.solution(i));
                 }
             }
         }
 
         if (mating.size() < num_min_population / 2) {
             for (size_t i = 0; i < num_min_population / 4; i++) {
-                mating.emplace_back(random_program());
+                mating.push_back(random_program());
             }
         }
 
@@ -131,7 +249,7 @@ public:
     population select_parents(evaluated_population const &pop) {
         // TODO: ugyanaz, mint a traveling_salesman-ben
         auto k = 8;
-        auto N = pop.size();
+        auto N = size(pop);
         std::vector<size_t> parent_indices;
 
         std::uniform_int_distribution<size_t> dist_index(0, N - 1);
@@ -151,7 +269,11 @@ public:
                     contender = generate_random_index();
                 }
 
-                if (pop[subject_idx].second < pop[contender].second) {
+                auto won = genetic::fitter(
+                    pop.fitness(subject_idx), pop.solution(subject_idx).size(),
+                    pop.fitness(contender), pop.solution(contender).size(),
+                    _bloat);
+                if (won) {
                     duels_won++;
                 }
                 duels_played++;
@@ -164,25 +286,24 @@ public:
         }
 
         population ret;
-        std::transform(
-            parent_indices.begin(), parent_indices.end(),
-            std::back_inserter(ret),
-            [&](auto i) { return pop[i].first; }
-        );
+        for (auto i : parent_indices) {
+            ret.push_back(pop.solution(i));
+        }
         return ret;
     }
 
     program crossover(population const &parents) {
         program ret;
-        auto &p0 = parents[0];
-        auto &p1 = parents[1];
+        auto p0 = parents[0];
+        auto p1 = parents[1];
 
-        auto dist_p0_idx = std::uniform_int_distribution(size_t(0), p0.size() - 1);
-        auto dist_p1_idx = std::uniform_int_distribution(size_t(0), p1.size() - 1);
+        auto [idx_p0, idx_p1] = genetic::crossover_points(p0.size(), p1.size(), _bloat, _rand);
 
-        auto idx_p0 = dist_p0_idx(_rand);
-        auto idx_p1 = dist_p1_idx(_rand);
+        if (genetic::exceeds_max_length(idx_p0 + (p1.size() - idx_p1), _bloat)) {
+            return program(p0.begin(), p0.end());
+        }
 
+        ret.reserve(idx_p0 + (p1.size() - idx_p1));
         ret.insert(ret.end(), p0.begin(), p0.begin() + idx_p0);
         ret.insert(ret.end(), p1.begin() + idx_p1, p1.end());
 
@@ -191,9 +312,9 @@ public:
 
     solution find_best_in(population const &pop) {
         auto pop_fit = evaluate(pop);
-        auto best = pop_fit[0];
-        printf("top fitness: %f | avg fitness: %f\n", best.second, average_fitness(pop_fit));
-        return best.first;
+        printf("top fitness: %f | avg fitness: %f | avg length: %.1f\n", pop_fit.fitness(0), average_fitness(pop_fit), average_length(pop));
+        auto best = pop_fit.solution(0);
+        return program(best.begin(), best.end());
     }
 
     void mutate(solution &prog, float chance) {
@@ -210,8 +331,8 @@ public:
         auto dist_op = std::uniform_int_distribution(int(OP_RELJMP_NC), int(OP_MAX - 1));
         auto op = dist_op(_rand);
         auto dist_param = std::uniform_int_distribution<size_t>(0, last_idx());
-        auto param_x = dist_param(_rand);
-        auto param_y = dist_param(_rand);
+        auto param_x = Operand(dist_param(_rand));
+        auto param_y = Operand(dist_param(_rand));
 
         return { operation(op), param_x, param_y };
     }
@@ -229,109 +350,522 @@ public:
         return ret;
     }
 
+    static size_t elite_count(size_t n_solutions) {
+        return n_solutions / 8;
+    }
+
     struct program_state {
-        std::deque<size_t> path;
+        ring_buffer<size_t> path;
+        // A kiindulo varosbol az utvonalon at oda visszatero kor hossza
+        double length = 0;
         bool flag_complete = false;
+        // A futast a levagasi korlat miatt allitottuk le
+        bool cut_off = false;
         int pc = 0;
         int steps = 0;
+
+        void reset(size_t capacity) {
+            path.reset(capacity);
+            length = 0;
+            flag_complete = false;
+            cut_off = false;
+            pc = 0;
+            steps = 0;
+        }
     };
 
+    // Szalankenti munkaterulet az interpreternek. A puffer csak akkor
+    // foglal memoriat, ha nagyobb peldanyt kapunk, mint amit eddig lattunk.
+    static program_state &scratch_state() {
+        static thread_local program_state state;
+        return state;
+    }
+
+    // Szalankenti munkateruletek a kanonikus alakhoz
+    static program &scratch_program() {
+        static thread_local program P;
+        return P;
+    }
+
+    template<typename Node>
+    static std::vector<Node> &scratch_nodes() {
+        static thread_local std::vector<Node> nodes;
+        return nodes;
+    }
+
+    static std::vector<int> &scratch_ints(int slot) {
+        static thread_local std::vector<int> buffers[5];
+        return buffers[slot];
+    }
+
+    static constexpr int max_steps = 1000;
+
+    // Egy futtatas allapota, amin az interpreter es a JIT altal forditott
+    // kod is dolgozik. Standard layout, mert a forditott kod a mezoit
+    // kozvetlenul, offset alapjan eri el.
+    //
+    // A `length` a kiindulo varosbol az utvonalon at oda visszatero kor
+    // aktualis hossza; az utasitasok csak a megvaltozott elek kulonbseget
+    // adjak hozza. Ha az utvonal kesz, es mar hosszabb, mint `cutoff`, a
+    // futas leall (`cut_off`).
+    struct exec_context {
+        ring_buffer<size_t> *path;
+        size_t next_city_index;
+        size_t start_idx;
+        size_t last_idx;
+        int pc;
+        int steps;
+        bool flag_complete;
+        bool cut_off;
+        City const *cities;
+        double length;
+        double cutoff;
+    };
+
+    // Lefuttatja a programot. A visszaadott allapot a szalankenti
+    // munkateruletre mutat, es csak a kovetkezo futtatasig ervenyes.
     template<typename Callback>
-    program_state execute_program(program const &P, Callback const &callback) {
-        program_state state;
+    program_state &execute_program(program_ref P, Callback const &callback) {
+        auto &state = scratch_state();
+        // A kiindulo varoson kivul minden varos legfeljebb egyszer kerul be
+        state.reset(_cities.size());
+
+        exec_context ctx = {
+            &state.path, 0, _start_idx, last_idx(), 0, 0, false, false,
+            _cities.data(), 0.0, double(_cutoff)
+        };
+
+#if TSP_PROGRAM_JIT
+        auto compiled = _use_jit ? _jit.get(P) : nullptr;
+        if (compiled != nullptr) {
+            compiled(&ctx);
+        } else {
+            interpret(P, ctx);
+        }
+#else
+        interpret(P, ctx);
+#endif
+
+        state.length = ctx.length;
+        state.flag_complete = ctx.flag_complete;
+        state.cut_off = ctx.cut_off;
+        state.pc = ctx.pc;
+        state.steps = ctx.steps;
+
+        GP_PROFILE_PROGRAM(_profile, ctx.steps, ctx.steps >= max_steps && !ctx.cut_off && ctx.pc >= 0 && ctx.pc < int(P.size()));
+        return state;
+    }
 
-        size_t next_city_index = 0;
+#if GP_PROFILING
+    using profile_stats = gp_profile::counters;
+
+    // Az utolso hivas ota gyujtott profil
+    profile_stats take_profile() {
+        auto ret = _profile;
+        _profile = {};
+        return ret;
+    }
+
+    static void print_profile(FILE *f, profile_stats const &stats) {
+        static char const *const names[] = { "jmp.nc", "add.front", "add.back", "rot.l", "rot.r", "swap", "perm.prev", "perm.next" };
+        stats.print(f, names, OP_MAX);
+    }
+#endif
 
-        while (state.steps < 1000 && state.pc >= 0 && state.pc < P.size()) {
+    // Be- vagy kikapcsolja a futas leallitasat, ha a kesz utvonal mar
+    // rosszabb a leggyengebb elitnel. A levagott program meg javulhatott
+    // volna a hatralevo lepeseiben, igy ez gyorsabb, de mohobb kivalasztas.
+    void set_elite_cutoff(bool enabled) {
+        _use_cutoff = enabled;
+    }
+
+    // Be- vagy kikapcsolja a JIT forditot (ha az adott platformon elerheto)
+    void set_jit(bool enabled) {
+#if TSP_PROGRAM_JIT
+        _use_jit = enabled;
+#endif
+    }
+
+    void interpret(program_ref P, exec_context &ctx) {
+        while (ctx.steps < max_steps && ctx.pc >= 0 && ctx.pc < P.size()) {
             // Fetch
-            auto &instr = P[state.pc];
-            state.steps++;
+            auto &instr = P[ctx.pc];
+            ctx.steps++;
+            GP_PROFILE_OP(_profile, instr.op);
 
             // Execute
-            auto next_pc = state.pc + 1;
+            auto next_pc = ctx.pc + 1;
+            bool stop = false;
             switch (instr.op) {
                 case OP_RELJMP_NC:
                 {
-                    if (!state.flag_complete) {
-                        auto rel = unsigned(instr.x);
-                        next_pc = state.pc - rel;
-                        if (next_pc < 0) {
-                            next_pc = 0;
-                        }
+                    if (!ctx.flag_complete) {
+                        next_pc = jump_target(ctx.pc, instr.x);
                     }
                     break;
                 }
-                case OP_PREPEND_NEXT:
-                {
-                    if (next_city_index == _start_idx) {
-                        next_city_index++;
-                    }
-                    if (next_city_index <= last_idx()) {
-                        state.path.push_front(next_city_index);
-                        next_city_index++;
-                    } else {
-                        state.flag_complete = true;
-                    }
-                    break;
+                case OP_PREPEND_NEXT: stop = op_prepend_next(&ctx, instr.x, instr.y); break;
+                case OP_APPEND_NEXT: stop = op_append_next(&ctx, instr.x, instr.y); break;
+                case OP_ROTATE_LEFT: stop = op_rotate_left(&ctx, instr.x, instr.y); break;
+                case OP_ROTATE_RIGHT: stop = op_rotate_right(&ctx, instr.x, instr.y); break;
+                case OP_SWAP: stop = op_swap(&ctx, instr.x, instr.y); break;
+                case OP_PREVPERM: stop = op_prevperm(&ctx, instr.x, instr.y); break;
+                case OP_NEXTPERM: stop = op_nextperm(&ctx, instr.x, instr.y); break;
+            }
+
+            ctx.pc = next_pc;
+            if (stop) {
+                break;
+            }
+        }
+    }
+
+    // Az `OP_RELJMP_NC` ugras celja; a JIT forditaskor ugyanigy szamolja ki
+    static int jump_target(int pc, size_t x) {
+        auto rel = unsigned(x);
+        int next_pc = pc - rel;
+        if (next_pc < 0) {
+            next_pc = 0;
+        }
+        return next_pc;
+    }
+
+    // Az utasitasok megvalositasa. Egyseges a szignaturajuk, hogy a JIT
+    // altal forditott kod is kozvetlenul meghivhassa oket. Mindegyik
+    // frissiti a kor hosszat, es igazzal ter vissza, ha a futast le kell
+    // allitani (lasd exec_context::cutoff).
+    static bool op_prepend_next(exec_context *ctx, size_t, size_t) {
+        if (ctx->next_city_index == ctx->start_idx) {
+            ctx->next_city_index++;
+        }
+        if (ctx->next_city_index <= ctx->last_idx) {
+            ctx->length -= edge_length(ctx, 0);
+            ctx->path->push_front(ctx->next_city_index);
+            ctx->length += edge_length(ctx, 0) + edge_length(ctx, 1);
+            ctx->next_city_index++;
+        } else {
+            ctx->flag_complete = true;
+        }
+        return check_cutoff(ctx);
+    }
+
+    static bool op_append_next(exec_context *ctx, size_t, size_t) {
+        if (ctx->next_city_index == ctx->start_idx) {
+            ctx->next_city_index++;
+        }
+        if (ctx->next_city_index <= ctx->last_idx) {
+            auto M = ctx->path->size();
+            ctx->length -= edge_length(ctx, M);
+            ctx->path->push_back(ctx->next_city_index);
+            ctx->length += edge_length(ctx, M) + edge_length(ctx, M + 1);
+            ctx->next_city_index++;
+        } else {
+            ctx->flag_complete = true;
+        }
+        return check_cutoff(ctx);
+    }
+
+    static bool op_rotate_left(exec_context *ctx, size_t, size_t) {
+        auto &path = *ctx->path;
+        auto M = path.size();
+        if (M > 1) {
+            ctx->length -= edge_length(ctx, 0) + edge_length(ctx, 1) + edge_length(ctx, M);
+            auto l = path.front();
+            path.pop_front();
+            path.push_back(l);
+            ctx->length += edge_length(ctx, 0) + edge_length(ctx, M - 1) + edge_length(ctx, M);
+        }
+        return check_cutoff(ctx);
+    }
+
+    static bool op_rotate_right(exec_context *ctx, size_t, size_t) {
+        auto &path = *ctx->path;
+        auto M = path.size();
+        if (M > 1) {
+            ctx->length -= edge_length(ctx, 0) + edge_length(ctx, M - 1) + edge_length(ctx, M);
+            auto r = path.back();
+            path.pop_back();
+            path.push_front(r);
+            ctx->length += edge_length(ctx, 0) + edge_length(ctx, 1) + edge_length(ctx, M);
+        }
+        return check_cutoff(ctx);
+    }
+
+    static bool op_swap(exec_context *ctx, size_t x, size_t y) {
+        auto &path = *ctx->path;
+        if (path.size() > 0) {
+            x = x % path.size();
+            y = y % path.size();
+            if (x != y) {
+                // Az x es y korul levo elek; szomszedos x, y eseten a kozos
+                // elt csak egyszer szamoljuk
+                if (x > y) {
+                    std::swap(x, y);
                 }
-                case OP_APPEND_NEXT:
-                {
-                    if (next_city_index == _start_idx) {
-                        next_city_index++;
-                    }
-                    if (next_city_index <= last_idx()) {
-                        state.path.push_back(next_city_index);
-                        next_city_index++;
-                    } else {
-                        state.flag_complete = true;
-                    }
-                    break;
+                auto adjacent = x + 1 == y;
+                auto around = [&]() {
+                    auto sum = edge_length(ctx, x) + edge_length(ctx, x + 1) + edge_length(ctx, y + 1);
+                    return adjacent ? sum : sum + edge_length(ctx, y);
+                };
+                ctx->length -= around();
+                std::swap(path[x], path[y]);
+                ctx->length += around();
+            }
+        }
+        return check_cutoff(ctx);
+    }
+
+    static bool op_prevperm(exec_context *ctx, size_t, size_t) {
+        auto &path = *ctx->path;
+        if (path.size() > 0) {
+            // A prev_permutation az elso olyan `i` utan valtoztat, ahol
+            // path[i] > path[i + 1]; ha nincs ilyen, a teljes utvonal megfordul
+            auto first = changed_suffix(path, [](size_t a, size_t b) { return a > b; });
+            ctx->length -= suffix_length(ctx, first);
+            std::prev_permutation(path.begin(), path.end());
+            ctx->length += suffix_length(ctx, first);
+        }
+        return check_cutoff(ctx);
+    }
+
+    static bool op_nextperm(exec_context *ctx, size_t, size_t) {
+        auto &path = *ctx->path;
+        if (path.size() > 0) {
+            auto first = changed_suffix(path, [](size_t a, size_t b) { return a < b; });
+            ctx->length -= suffix_length(ctx, first);
+            std::next_permutation(path.begin(), path.end());
+            ctx->length += suffix_length(ctx, first);
+        }
+        return check_cutoff(ctx);
+    }
+
+    // A kor k. ele az utvonal (k - 1). es k. varosa kozott fut; a -1. es az
+    // M. "varos" a kiindulo varos, igy a kornek M + 1 ele van
+    static double edge_length(exec_context *ctx, size_t k) {
+        auto &path = *ctx->path;
+        auto M = path.size();
+        auto a = k == 0 ? ctx->start_idx : path[k - 1];
+        auto b = k == M ? ctx->start_idx : path[k];
+        return distance(ctx->cities[a], ctx->cities[b]);
+    }
+
+    // A `first`. es utana kovetkezo elek hossza
+    static double suffix_length(exec_context *ctx, size_t first) {
+        double sum = 0;
+        for (size_t k = first; k <= ctx->path->size(); k++) {
+            sum += edge_length(ctx, k);
+        }
+        return sum;
+    }
+
+    // Az elso el indexe, amit egy permutacios lepes megvaltoztathat: a
+    // leghatso `i`, amire pivot(path[i], path[i + 1]) igaz (vagy 0)
+    template<typename Pivot>
+    static size_t changed_suffix(ring_buffer<size_t> &path, Pivot const &pivot) {
+        for (auto i = path.size() - 1; i > 0; i--) {
+            if (pivot(path[i - 1], path[i])) {
+                return i - 1;
+            }
+        }
+        return 0;
+    }
+
+    static bool check_cutoff(exec_context *ctx) {
+        if (ctx->flag_complete && ctx->length > ctx->cutoff) {
+            ctx->cut_off = true;
+        }
+        return ctx->cut_off;
+    }
+
+    // A program kanonikus alakja. Az atalakitasok (a lepesszam-korlattol
+    // eltekintve) nem valtoztatnak a program eredmenyen:
+    //   - elhagyja az elerhetetlen utasitasokat. Ugrani csak hatrafele lehet,
+    //     es a jmp.nc csak akkor nem ugrik, ha mar kesz az utvonal; ha egy
+    //     jmp.nc-nel az utvonal biztosan nincs kesz (eddig semmilyen
+    //     uton nem futott add.*), akkor az utana levo kod elerhetetlen;
+    //   - kiejti az egymast koveto inverz parokat (rot.l/rot.r,
+    //     perm.next/perm.prev, ket azonos swap), ha a masodik tagjuk nem
+    //     ugrascel, es elhagyja a `swap x, x` utasitasokat;
+    //   - normalizalja az operandusokat: a nem hasznalt operandusok 0-k, a
+    //     swap operandusai novekvo sorrendben vannak, a jmp.nc tavolsaga
+    //     legfeljebb az utasitas indexe (messzebbre ugrani is a 0. utasitasra
+    //     vezet).
+    // A swap operandusait nem redukaljuk az utvonal hosszaval, mert az a
+    // futas kozben valtozik.
+    void canonicalize(program_ref P, program &out) {
+        auto N = int(P.size());
+        if (P.size() > size_t(std::numeric_limits<Operand>::max())) {
+            // Az uj ugrasi tavolsagok nem feltetlenul fernenek el
+            out.assign(P.begin(), P.end());
+            return;
+        }
+
+        struct node {
+            instruction I;
+            int target;
+            bool alive;
+        };
+
+        auto &nodes = scratch_nodes<node>();
+        nodes.clear();
+        for (int i = 0; i < N; i++) {
+            auto &I = P[i];
+            int target = -1;
+            if (I.op == OP_RELJMP_NC) {
+                target = jump_target(i, I.x);
+                if (target > i) {
+                    // Csak hatrafele ugro programokat tudunk atirni
+                    out.assign(P.begin(), P.end());
+                    return;
                 }
-                case OP_ROTATE_LEFT:
-                {
-                    if (state.path.size() > 0) {
-                        auto l = state.path.front();
-                        state.path.pop_front();
-                        state.path.push_back(l);
-                    }
-                    break;
+            }
+            nodes.push_back({ I, target, true });
+        }
+
+        auto &next_alive = scratch_ints(0);
+        auto &in_flag = scratch_ints(1);
+        auto &is_target = scratch_ints(2);
+        auto &worklist = scratch_ints(3);
+
+        // next_alive[i]: az elso elo utasitas indexe, ami >= i (vagy N)
+        auto update_next_alive = [&]() {
+            next_alive.resize(N + 1);
+            next_alive[N] = N;
+            for (int i = N - 1; i >= 0; i--) {
+                next_alive[i] = nodes[i].alive ? i : next_alive[i + 1];
+            }
+        };
+
+        auto is_add = [](operation op) {
+            return op == OP_PREPEND_NEXT || op == OP_APPEND_NEXT;
+        };
+
+        auto is_inverse = [](instruction const &a, instruction const &b) {
+            switch (a.op) {
+                case OP_ROTATE_LEFT: return b.op == OP_ROTATE_RIGHT;
+                case OP_ROTATE_RIGHT: return b.op == OP_ROTATE_LEFT;
+                case OP_PREVPERM: return b.op == OP_NEXTPERM;
+                case OP_NEXTPERM: return b.op == OP_PREVPERM;
+                case OP_SWAP:
+                    return b.op == OP_SWAP &&
+                        ((a.x == b.x && a.y == b.y) || (a.x == b.y && a.y == b.x));
+                default: return false;
+            }
+        };
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            update_next_alive();
+
+            // Elerhetoseg: -1 = nem elerheto, 0 = elerheto es az utvonal
+            // biztosan nincs kesz, 1 = elerheto es lehet, hogy kesz
+            in_flag.assign(N + 1, -1);
+            worklist.clear();
+            auto reach = [&](int i, int flag) {
+                i = next_alive[i];
+                if (i < N && in_flag[i] < flag) {
+                    in_flag[i] = flag;
+                    worklist.push_back(i);
                 }
-                case OP_ROTATE_RIGHT:
-                {
-                    if (state.path.size() > 0) {
-                        auto r = state.path.back();
-                        state.path.pop_back();
-                        state.path.push_front(r);
+            };
+            reach(0, 0);
+            while (!worklist.empty()) {
+                auto i = worklist.back();
+                worklist.pop_back();
+                auto flag = in_flag[i];
+                auto &n = nodes[i];
+
+                if (n.I.op == OP_RELJMP_NC) {
+                    reach(n.target, flag);
+                    if (flag == 1) {
+                        reach(i + 1, flag);
                     }
-                    break;
+                } else {
+                    reach(i + 1, is_add(n.I.op) ? 1 : flag);
                 }
-                case OP_SWAP:
-                {
-                    if (state.path.size() > 0) {
-                        auto x = instr.x;
-                        auto y = instr.y;
-                        x = x % state.path.size();
-                        y = y % state.path.size();
-                        std::swap(state.path[x], state.path[y]);
-                    }
-                    break;
+            }
+
+            for (int i = 0; i < N; i++) {
+                auto dead = in_flag[i] < 0 ||
+                    (nodes[i].I.op == OP_SWAP && nodes[i].I.x == nodes[i].I.y);
+                if (nodes[i].alive && dead) {
+                    nodes[i].alive = false;
+                    changed = true;
                 }
-                case OP_PREVPERM:
-                    if (state.path.size() > 0) {
-                        std::prev_permutation(state.path.begin(), state.path.end());
-                    }
+            }
+            if (changed) {
+                continue;
+            }
+
+            is_target.assign(N + 1, 0);
+            for (int i = 0; i < N; i++) {
+                if (nodes[i].alive && nodes[i].I.op == OP_RELJMP_NC) {
+                    is_target[next_alive[nodes[i].target]] = 1;
+                }
+            }
+
+            for (int i = next_alive[0]; i < N; ) {
+                auto j = next_alive[i + 1];
+                if (j < N && !is_target[j] && is_inverse(nodes[i].I, nodes[j].I)) {
+                    nodes[i].alive = false;
+                    nodes[j].alive = false;
+                    changed = true;
+                    i = next_alive[j + 1];
+                } else {
+                    i = j;
+                }
+            }
+        }
+
+        // Az elo utasitasok uj indexe
+        update_next_alive();
+        auto &new_index = scratch_ints(4);
+        new_index.assign(N + 1, 0);
+        int n_alive = 0;
+        for (int i = 0; i < N; i++) {
+            new_index[i] = n_alive;
+            if (nodes[i].alive) {
+                n_alive++;
+            }
+        }
+        new_index[N] = n_alive;
+
+        out.clear();
+        for (int i = 0; i < N; i++) {
+            auto &n = nodes[i];
+            if (!n.alive) {
+                continue;
+            }
+
+            auto I = n.I;
+            switch (I.op) {
+                case OP_RELJMP_NC:
+                    I.x = Operand(new_index[i] - new_index[next_alive[n.target]]);
+                    I.y = 0;
                     break;
-                case OP_NEXTPERM:
-                    if (state.path.size() > 0) {
-                        std::next_permutation(state.path.begin(), state.path.end());
+                case OP_SWAP:
+                    if (I.x > I.y) {
+                        std::swap(I.x, I.y);
                     }
                     break;
+                default:
+                    I.x = 0;
+                    I.y = 0;
+                    break;
             }
-
-            state.pc = next_pc;
+            out.push_back(I);
         }
+    }
 
-        return state;
+    // Ket fuggetlen 64 bites hash a program tartalmarol (a fitness es a
+    // JIT gyorsitotar kulcsa)
+    static std::pair<uint64_t, uint64_t> hash(program_ref P) {
+        return genetic::program_hash(P, [](instruction const &I, auto const &mix) {
+            mix(uint64_t(I.op));
+            mix(uint64_t(I.x));
+            mix(uint64_t(I.y));
+        });
     }
 
     void disassemble(instruction const &I, char const *&mnemonic, size_t &param0, size_t &param1) {
@@ -349,7 +883,7 @@ public:
         }
     }
 
-    void print_program(solution const &P) {
+    void print_program(program_ref P) {
         printf("====================\n");
         printf("DISASSEMBLY\n");
         for (auto &instr : P) {
@@ -373,4 +907,32 @@ private:
     const size_t program_min_length = 32;
     const size_t program_max_length = 128;
     const size_t num_min_population = 100;
+    static constexpr size_t fitness_cache_max_size = size_t(1) << 20;
+    static constexpr size_t fitness_cache_max_instructions = size_t(1) << 23;
+
+    // A leggyengebb elit fitness-e az eppen futo kiertekelesben
+    float _cutoff = INFINITY;
+    bool _use_cutoff = true;
+
+    genetic::bloat_control _bloat;
+
+#if GP_PROFILING
+    gp_profile::counters _profile;
+#endif
+
+    // Kanonikus program hash -> (masodik hash, fitness, a program indexe a
+    // _fitness_cache_programs-ban). Talalatkor a tarolt programot is
+    // osszehasonlitjuk, igy hash-utkozes nem adhat rossz fitnesst.
+    struct cached_fitness {
+        uint64_t check;
+        float fitness;
+        uint32_t program;
+    };
+    std::unordered_map<uint64_t, cached_fitness> _fitness_cache;
+    population _fitness_cache_programs;
+
+#if TSP_PROGRAM_JIT
+    tsp_jit::compiler<traveling_salesman_program, instruction> _jit;
+    bool _use_jit = true;
+#endif
 };
\ No newline at end of file
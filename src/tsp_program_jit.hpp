@@ -0,0 +1,368 @@
+#pragma once
+
+// JIT fordito a traveling_salesman_program programjaihoz (x86-64, Linux).
+//
+// Minden programot egyszer forditunk gepi kodra egy mmap-elt, futtathato
+// teruletre, es utana tobbszor futtatjuk (a programok sok generacion at
+// elnek). A forditott kodban:
+//   - minden utasitasnak sajat cimkeje van, az ugrasok kozvetlen
+//     (rel32) ugrasok, a celjukat forditaskor szamoljuk ki;
+//   - a lepesszamlalo vegig az r12d regiszterben van;
+//   - a permutacios muveletek a traveling_salesman_program op_* fuggvenyeire
+//     forditott kozvetlen hivasok, a kontextus mutatoja az rbx-ben marad;
+//     ha a fuggveny igazzal ter vissza (levagas), a program kilep.
+//
+// Mas platformokon (vagy TSP_PROGRAM_NO_JIT definialasa eseten) a
+// TSP_PROGRAM_JIT erteke 0, es az interpreter fut. Profilozaskor (GP_PROFILE)
+// is az interpreter fut, mert csak az gyujt statisztikat.
+//
+// A fordito (es a gyorsitotar) nem szalbiztos.
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(TSP_PROGRAM_NO_JIT) && !defined(GP_PROFILE)
+#define TSP_PROGRAM_JIT 1
+#else
+#define TSP_PROGRAM_JIT 0
+#endif
+
+#if TSP_PROGRAM_JIT
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <initializer_list>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "program_arena.hpp"
+
+namespace tsp_jit {
+    // Futtathato memoria, amibe a leforditott programok kerulnek. Iras
+    // kozben az erintett lapok RW-k, egyebkent RX-ek (W^X). Ha a lapok
+    // vedelme nem allithato at, a terulet hasznalhatatlanna valik
+    // (failed()); a mar kiadott kod sem futtathato tobbe.
+    class code_arena {
+    public:
+        code_arena(size_t size) : _size(size) {
+            auto mem = mmap(nullptr, _size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) {
+                fprintf(stderr, "tsp_jit::code_arena: mmap failed\n");
+                std::abort();
+            }
+            _base = static_cast<uint8_t *>(mem);
+            _page_size = size_t(sysconf(_SC_PAGESIZE));
+        }
+
+        code_arena(code_arena const &) = delete;
+        code_arena &operator=(code_arena const &) = delete;
+
+        ~code_arena() {
+            munmap(_base, _size);
+        }
+
+        // Bemasolja a kodot; nullptr-rel ter vissza, ha elfogyott a hely
+        void *emit(std::vector<uint8_t> const &code) {
+            auto offset = (_used + 15) & ~size_t(15);
+            if (offset + code.size() > _size) {
+                return nullptr;
+            }
+
+            auto first_page = offset & ~(_page_size - 1);
+            auto last = offset + code.size();
+            auto len = last - first_page;
+
+            if (mprotect(_base + first_page, len, PROT_READ | PROT_WRITE) != 0) {
+                fail();
+                return nullptr;
+            }
+            memcpy(_base + offset, code.data(), code.size());
+            if (mprotect(_base + first_page, len, PROT_READ | PROT_EXEC) != 0) {
+                fail();
+                return nullptr;
+            }
+            __builtin___clear_cache(reinterpret_cast<char *>(_base + offset), reinterpret_cast<char *>(_base + last));
+
+            _used = last;
+            return _base + offset;
+        }
+
+        void reset() {
+            _used = 0;
+        }
+
+        bool failed() const {
+            return _failed;
+        }
+
+    private:
+        void fail() {
+            fprintf(stderr, "tsp_jit::code_arena: mprotect failed (%s), falling back to the interpreter\n", strerror(errno));
+            _failed = true;
+        }
+
+    private:
+        uint8_t *_base;
+        size_t _size;
+        size_t _used = 0;
+        size_t _page_size;
+        bool _failed = false;
+    };
+
+    // x86-64 kodgeneralas a forditohoz
+    class assembler {
+    public:
+        std::vector<uint8_t> code;
+
+        void byte(uint8_t b) {
+            code.push_back(b);
+        }
+
+        void bytes(std::initializer_list<uint8_t> bs) {
+            code.insert(code.end(), bs);
+        }
+
+        void u32(uint32_t v) {
+            for (int i = 0; i < 4; i++) {
+                byte(uint8_t(v >> (8 * i)));
+            }
+        }
+
+        void u64(uint64_t v) {
+            for (int i = 0; i < 8; i++) {
+                byte(uint8_t(v >> (8 * i)));
+            }
+        }
+
+        size_t pos() const {
+            return code.size();
+        }
+
+        // Egy rel32 mezo helyet foglalja le; a celt kesobb a patch() irja be
+        size_t rel32_placeholder() {
+            auto at = pos();
+            u32(0);
+            return at;
+        }
+
+        void patch(size_t at, size_t target) {
+            auto rel = int32_t(int64_t(target) - int64_t(at + 4));
+            memcpy(code.data() + at, &rel, 4);
+        }
+    };
+
+    // Program -> gepi kod fordito, gyorsitotarral.
+    //
+    // `Problem` a traveling_salesman_program egy peldanyositasa; annak
+    // exec_context, program, instruction tipusait, jump_target-jet es op_*
+    // fuggvenyeit hasznaljuk. Mivel a fordito a Problem tagja, a Problem
+    // tipusait csak a tagfuggvenyek torzseben erjuk el (ott mar teljes a
+    // tipus); az utasitas tipusat ezert kulon kapjuk (`Instruction`), a
+    // gyorsitotarban tarolt programokhoz.
+    template<typename Problem, typename Instruction>
+    class compiler {
+    public:
+        compiler(size_t arena_size = size_t(64) << 20) : _arena(arena_size) {
+        }
+
+        compiler(compiler const &) = delete;
+        compiler &operator=(compiler const &) = delete;
+
+        // Visszaadja a program leforditott valtozatat; ha meg nincs a
+        // gyorsitotarban, leforditja. A gyorsitotar kulcsa a Problem::hash,
+        // de talalatkor a tarolt programot is osszehasonlitjuk, igy
+        // hash-utkozes eseten sem futhat egy masik program kodja. nullptr,
+        // ha a kod nem teheto futtathatova (ekkor az interpreter fusson).
+        template<typename Program>
+        auto get(Program const &P) {
+            using entry_fn = void (*)(typename Problem::exec_context *);
+            if (_arena.failed()) {
+                return entry_fn(nullptr);
+            }
+
+            auto h = Problem::hash(P);
+            auto it = _cache.find(h.first);
+            if (it != _cache.end() && it->second.check == h.second) {
+                auto stored = _programs[it->second.program];
+                if (std::equal(stored.begin(), stored.end(), P.begin(), P.end())) {
+                    return reinterpret_cast<entry_fn>(it->second.fn);
+                }
+            }
+
+            auto code = compile(P);
+            auto mem = _arena.emit(code);
+            if (mem == nullptr && !_arena.failed()) {
+                // Betelt a terulet: mindent eldobunk es elolrol kezdjuk
+                _cache.clear();
+                _programs.clear();
+                _arena.reset();
+                mem = _arena.emit(code);
+                if (mem == nullptr && !_arena.failed()) {
+                    fprintf(stderr, "tsp_jit::compiler: program does not fit into the code arena\n");
+                    std::abort();
+                }
+            }
+            if (mem == nullptr) {
+                _cache.clear();
+                _programs.clear();
+                return entry_fn(nullptr);
+            }
+
+            _programs.push_back(P);
+            _cache[h.first] = { h.second, mem, uint32_t(_programs.size() - 1) };
+            return reinterpret_cast<entry_fn>(mem);
+        }
+
+    private:
+        template<typename Operation>
+        static void *helper(Operation op) {
+            switch (op) {
+            case Problem::OP_PREPEND_NEXT: return reinterpret_cast<void *>(&Problem::op_prepend_next);
+            case Problem::OP_APPEND_NEXT: return reinterpret_cast<void *>(&Problem::op_append_next);
+            case Problem::OP_ROTATE_LEFT: return reinterpret_cast<void *>(&Problem::op_rotate_left);
+            case Problem::OP_ROTATE_RIGHT: return reinterpret_cast<void *>(&Problem::op_rotate_right);
+            case Problem::OP_SWAP: return reinterpret_cast<void *>(&Problem::op_swap);
+            case Problem::OP_PREVPERM: return reinterpret_cast<void *>(&Problem::op_prevperm);
+            case Problem::OP_NEXTPERM: return reinterpret_cast<void *>(&Problem::op_nextperm);
+            default: return nullptr;
+            }
+        }
+
+        template<typename Program>
+        static std::vector<uint8_t> compile(Program const &P) {
+            using context = typename Problem::exec_context;
+            constexpr uint32_t off_pc = offsetof(context, pc);
+            constexpr uint32_t off_steps = offsetof(context, steps);
+            constexpr uint32_t off_flag = offsetof(context, flag_complete);
+
+            auto N = P.size();
+            assembler a;
+
+            // Ugrasok, amiknek a celjat a vegen irjuk be
+            struct fixup {
+                size_t at;
+                size_t label;
+            };
+            std::vector<fixup> fixups;
+            std::vector<size_t> labels(N + 1);
+            // A lepesszam-korlat miatti kilepesek (utasitasonkent) es a
+            // programon kivulre mutato ugrasok kilepesi pontjai
+            std::vector<size_t> limit_exits(N);
+            std::vector<std::pair<size_t, int>> far_jumps;
+            std::vector<std::pair<size_t, int>> stop_exits;
+
+            // push rbx; push r12; sub rsp, 8 (a hivasokhoz 16 bajtra igazitva)
+            a.bytes({ 0x53, 0x41, 0x54, 0x48, 0x83, 0xEC, 0x08 });
+            // mov rbx, rdi; xor r12d, r12d
+            a.bytes({ 0x48, 0x89, 0xFB, 0x45, 0x31, 0xE4 });
+
+            for (size_t i = 0; i < N; i++) {
+                labels[i] = a.pos();
+                auto &I = P[i];
+
+                // cmp r12d, max_steps; jae limit_exit_i; inc r12d
+                a.bytes({ 0x41, 0x81, 0xFC });
+                a.u32(Problem::max_steps);
+                a.bytes({ 0x0F, 0x83 });
+                limit_exits[i] = a.rel32_placeholder();
+                a.bytes({ 0x41, 0xFF, 0xC4 });
+
+                if (I.op == Problem::OP_RELJMP_NC) {
+                    auto target = Problem::jump_target(int(i), I.x);
+                    // cmp byte [rbx + flag], 0; je target
+                    a.bytes({ 0x80, 0xBB });
+                    a.u32(off_flag);
+                    a.byte(0);
+                    a.bytes({ 0x0F, 0x84 });
+                    auto at = a.rel32_placeholder();
+                    if (target < int(N)) {
+                        fixups.push_back({ at, size_t(target) });
+                    } else {
+                        far_jumps.emplace_back(at, target);
+                    }
+                    continue;
+                }
+
+                auto fn = helper(I.op);
+                if (fn == nullptr) {
+                    continue;
+                }
+
+                // mov rdi, rbx; mov rsi, x; mov rdx, y; mov rax, fn; call rax
+                a.bytes({ 0x48, 0x89, 0xDF });
+                a.bytes({ 0x48, 0xBE });
+                a.u64(uint64_t(I.x));
+                a.bytes({ 0x48, 0xBA });
+                a.u64(uint64_t(I.y));
+                a.bytes({ 0x48, 0xB8 });
+                a.u64(reinterpret_cast<uint64_t>(fn));
+                a.bytes({ 0xFF, 0xD0 });
+                // test al, al; jnz stop_exit (pc = i + 1)
+                a.bytes({ 0x84, 0xC0, 0x0F, 0x85 });
+                stop_exits.emplace_back(a.rel32_placeholder(), int(i + 1));
+            }
+
+            // A program vegere ertunk: pc = N
+            labels[N] = a.pos();
+            std::vector<size_t> epilogue_jumps;
+            auto emit_exit = [&](int pc) {
+                // mov dword [rbx + pc], imm32; jmp epilogue
+                a.bytes({ 0xC7, 0x83 });
+                a.u32(off_pc);
+                a.u32(uint32_t(pc));
+                a.byte(0xE9);
+                epilogue_jumps.push_back(a.rel32_placeholder());
+            };
+            emit_exit(int(N));
+
+            for (size_t i = 0; i < N; i++) {
+                a.patch(limit_exits[i], a.pos());
+                emit_exit(int(i));
+            }
+
+            for (auto &fj : far_jumps) {
+                a.patch(fj.first, a.pos());
+                emit_exit(fj.second);
+            }
+
+            for (auto &se : stop_exits) {
+                a.patch(se.first, a.pos());
+                emit_exit(se.second);
+            }
+
+            // mov [rbx + steps], r12d; add rsp, 8; pop r12; pop rbx; ret
+            auto epilogue = a.pos();
+            a.bytes({ 0x44, 0x89, 0xA3 });
+            a.u32(off_steps);
+            a.bytes({ 0x48, 0x83, 0xC4, 0x08, 0x41, 0x5C, 0x5B, 0xC3 });
+
+            for (auto at : epilogue_jumps) {
+                a.patch(at, epilogue);
+            }
+            for (auto &f : fixups) {
+                a.patch(f.at, labels[f.label]);
+            }
+
+            return std::move(a.code);
+        }
+
+        struct cached {
+            uint64_t check;
+            void *fn;
+            uint32_t program;
+        };
+
+    private:
+        code_arena _arena;
+        std::unordered_map<uint64_t, cached> _cache;
+        // A leforditott programok (a talalatok ellenorzesehez)
+        program_arena<Instruction> _programs;
+    };
+}
+
+#endif
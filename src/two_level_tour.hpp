@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// Ket szintu tura reprezentacio (2-level list), gyors szakaszmegforditassal.
+//
+// A varosok tura szerinti sorrendben ~sqrt(N) meretu szegmensekre vannak
+// osztva. Minden szegmens tarolja a sajat varosait es egy "megforditott"
+// bitet, ami megmondja, hogy a varosait visszafele kell-e olvasni. A
+// szegmensek sorrendjet a `_order` tomb adja meg.
+//
+// Egy szakasz megforditasakor a szakasz ket veget szegmenshatarra vagjuk, majd
+// a koztes szegmensek sorrendjet megforditjuk es a bitjeiket atbillentjuk;
+// ez O(sqrt N) lepes a tomb alapu reprezentacio O(N)-jevel szemben.
+// A next/prev/between lekerdezesek O(1)-esek.
+//
+// A tura ciklikus: az utolso varos utan ujra az elso jon.
+class two_level_tour {
+public:
+    using city_t = uint32_t;
+
+    two_level_tour() = default;
+
+    template<typename Path>
+    explicit two_level_tour(Path const &tour) {
+        assign(tour);
+    }
+
+    // Feltolti a szerkezetet egy tomb alapu turabol
+    template<typename Path>
+    void assign(Path const &tour) {
+        auto N = tour.size();
+
+        _group_size = std::max(size_t(1), size_t(std::ceil(std::sqrt(double(N)))));
+        _city_segment.assign(N, 0);
+        _city_offset.assign(N, 0);
+        _segments.clear();
+        _order.clear();
+
+        for (size_t first = 0; first < N; first += _group_size) {
+            auto last = std::min(N, first + _group_size);
+            segment seg;
+            seg.cities.assign(tour.begin() + first, tour.begin() + last);
+            _segments.push_back(std::move(seg));
+            _order.push_back(_segments.size() - 1);
+        }
+
+        _max_groups = 2 * _order.size() + 2;
+
+        for (size_t sid = 0; sid < _segments.size(); sid++) {
+            _segments[sid].rank = sid;
+            update_cities(sid);
+        }
+    }
+
+    // Kiirja a turat `out`-ba, `first`-tol kezdve, elore vagy hatrafele
+    // haladva
+    template<typename Path>
+    void write(Path &out, city_t first, bool forward = true) const {
+        auto N = size();
+        out.resize(N);
+        auto c = first;
+        for (size_t i = 0; i < N; i++) {
+            out[i] = typename Path::value_type(c);
+            c = forward ? next(c) : prev(c);
+        }
+    }
+
+    size_t size() const {
+        return _city_segment.size();
+    }
+
+    city_t next(city_t c) const {
+        auto &seg = _segments[_city_segment[c]];
+        auto lp = logical_position(c);
+        if (lp + 1 < seg.cities.size()) {
+            return at(seg, lp + 1);
+        }
+        auto &seg_next = _segments[_order[(seg.rank + 1) % _order.size()]];
+        return at(seg_next, 0);
+    }
+
+    city_t prev(city_t c) const {
+        auto &seg = _segments[_city_segment[c]];
+        auto lp = logical_position(c);
+        if (lp > 0) {
+            return at(seg, lp - 1);
+        }
+        auto &seg_prev = _segments[_order[(seg.rank + _order.size() - 1) % _order.size()]];
+        return at(seg_prev, seg_prev.cities.size() - 1);
+    }
+
+    // Rajta van-e `b` az `a`-bol elore `c`-ig vezeto szakaszon (a vegeket is
+    // beleertve)?
+    bool between(city_t a, city_t b, city_t c) const {
+        auto ka = key(a);
+        auto kb = key(b);
+        auto kc = key(c);
+
+        if (ka <= kc) {
+            return ka <= kb && kb <= kc;
+        }
+        return ka <= kb || kb <= kc;
+    }
+
+    // Megforditja az `a`-bol elore `b`-ig tarto szakaszt (a vegeket is
+    // beleertve). Ha a szakasz atlog a `_order` vegen, akkor a komplementeret
+    // forditjuk meg, ami ciklikus turanal ugyanazt az el-halmazt adja.
+    void reverse(city_t a, city_t b) {
+        if (a == b) {
+            return;
+        }
+
+        auto after = next(b);
+        if (after == a) {
+            // A teljes turat kell megforditani
+            reverse_ranks(0, _order.size() - 1);
+            return;
+        }
+
+        split_before(a);
+        split_before(after);
+
+        auto rank_a = _segments[_city_segment[a]].rank;
+        auto rank_b = _segments[_city_segment[b]].rank;
+
+        if (rank_a <= rank_b) {
+            reverse_ranks(rank_a, rank_b);
+        } else {
+            auto rank_after = _segments[_city_segment[after]].rank;
+            reverse_ranks(rank_after, rank_a - 1);
+        }
+
+        // Minden megforditas legfeljebb ket uj szegmenst hoz letre; ha tul sok
+        // lett belole, ujraepitjuk a szerkezetet (amortizalt O(sqrt N))
+        if (_order.size() > _max_groups) {
+            rebuild();
+        }
+    }
+
+private:
+    struct segment {
+        std::vector<city_t> cities;
+        bool reversed = false;
+        size_t rank = 0;
+    };
+
+    size_t logical_position(city_t c) const {
+        auto &seg = _segments[_city_segment[c]];
+        auto off = _city_offset[c];
+        return seg.reversed ? seg.cities.size() - 1 - off : off;
+    }
+
+    static city_t at(segment const &seg, size_t lp) {
+        return seg.reversed ? seg.cities[seg.cities.size() - 1 - lp] : seg.cities[lp];
+    }
+
+    std::pair<size_t, size_t> key(city_t c) const {
+        return { _segments[_city_segment[c]].rank, logical_position(c) };
+    }
+
+    void update_cities(size_t sid) {
+        auto &cities = _segments[sid].cities;
+        for (size_t i = 0; i < cities.size(); i++) {
+            _city_segment[cities[i]] = uint32_t(sid);
+            _city_offset[cities[i]] = uint32_t(i);
+        }
+    }
+
+    // Ketteosztja `c` szegmenset ugy, hogy `c` egy szegmens elejere keruljon
+    void split_before(city_t c) {
+        auto sid = _city_segment[c];
+        auto lp = logical_position(c);
+        if (lp == 0) {
+            return;
+        }
+
+        segment tail;
+        {
+            auto &seg = _segments[sid];
+            auto n = seg.cities.size();
+            tail.reversed = seg.reversed;
+            if (!seg.reversed) {
+                // A logikai [lp, n) fizikailag is [lp, n)
+                tail.cities.assign(seg.cities.begin() + lp, seg.cities.end());
+                seg.cities.resize(lp);
+            } else {
+                // A logikai [lp, n) fizikailag [0, n - lp)
+                tail.cities.assign(seg.cities.begin(), seg.cities.begin() + (n - lp));
+                seg.cities.erase(seg.cities.begin(), seg.cities.begin() + (n - lp));
+                update_cities(sid);
+            }
+        }
+
+        auto rank = _segments[sid].rank;
+        auto tid = _segments.size();
+        _segments.push_back(std::move(tail));
+        update_cities(tid);
+
+        _order.insert(_order.begin() + rank + 1, tid);
+        for (size_t r = rank + 1; r < _order.size(); r++) {
+            _segments[_order[r]].rank = r;
+        }
+    }
+
+    void reverse_ranks(size_t first, size_t last) {
+        std::reverse(_order.begin() + first, _order.begin() + last + 1);
+        for (size_t r = first; r <= last; r++) {
+            auto &seg = _segments[_order[r]];
+            seg.reversed = !seg.reversed;
+            seg.rank = r;
+        }
+    }
+
+    void rebuild() {
+        if (size() == 0) {
+            return;
+        }
+        std::vector<city_t> flat;
+        write(flat, at(_segments[_order[0]], 0));
+        assign(flat);
+    }
+
+private:
+    std::vector<segment> _segments;
+    std::vector<size_t> _order;
+    std::vector<uint32_t> _city_segment;
+    std::vector<uint32_t> _city_offset;
+    size_t _group_size = 1;
+    size_t _max_groups = 2;
+};